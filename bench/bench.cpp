@@ -0,0 +1,420 @@
+// Microbenchmarks for the geometry and rendering hot paths.
+//
+// Every benchmark runs over maps of increasing size, the results are written
+// as JSON and compared against a baseline written by an earlier run. A result
+// that is slower than the baseline by more than the threshold fails the run.
+// Built with ALLOC_TRACKING=1, a benchmark that allocates after its first run fails it too.
+
+#include <Map.h>
+#include <CompactMap.h>
+#include <MapGen.h>
+#include <Renderer.h>
+#include <BatchRenderer.h>
+#include <Visibility.h>
+#include <RayCast.h>
+#include <Animation.h>
+#include <AllocTracker.h>
+#include <Framebuffer.h>
+#include <PerfHud.h>
+#include <Player.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+const int BENCH_WIDTH       = 640;
+const int BENCH_HEIGHT      = 480;
+const int BENCH_REPEATS     = 5;
+const double BENCH_MIN_SECONDS = 0.05;
+const int BATCH_CAMERAS     = 256;
+const int BATCH_WIDTH       = 160;
+const int BATCH_HEIGHT      = 120;
+const int BATCH_RAYS        = 4096;
+
+struct Timing {
+    double ns_per_op;
+    unsigned long long allocations;     // After the first run, only counted with ALLOC_TRACKING
+};
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    unsigned long long allocations;
+
+    Result(const std::string& name, Timing timing) : name(name), ns_per_op(timing.ns_per_op), allocations(timing.allocations) {}
+};
+
+// Keeps results alive so the timed code isn't optimized away
+static volatile unsigned long long sink;
+
+// Runs f (which performs ops operations) once to warm up, then until at least BENCH_MIN_SECONDS
+// have passed, repeats that BENCH_REPEATS times and returns the fastest time per operation
+// and the heap allocations of all runs after the first
+template<class F> static Timing timeNs(F f, size_t ops) {
+    f();
+    AllocCounts before = allocTotals();
+    double best = INFINITY;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        size_t runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed;
+        do {
+            f();
+            runs++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < BENCH_MIN_SECONDS);
+        best = std::min(best, elapsed * 1e9 / double(runs * ops));
+    }
+    return {best, (allocTotals() - before).allocations};
+}
+
+static Map generatedMap(MapLayout layout, int sectors, int walls_per_sector) {
+    Map map;
+    generateMap({layout, sectors, walls_per_sector, 0.5f, 1, 4.0f}, map.walls, map.sectors);
+    map.build();
+    return map;
+}
+
+// Checks whose images differed from the ones they have to match
+static int mismatches = 0;
+
+// Two rooms a quarter unit apart, whose facing walls round to the same vertex at precision 0.
+// Sliding one room must not drag the other along in the compact layout.
+static void checkCompactSlide() {
+    Map map;
+    auto room = [&](float x0, float x1) {
+        int begin = map.walls.size();
+        map.walls.push_back({{x0, 0.0f}, {x0, 4.0f}, -1});
+        map.walls.push_back({{x0, 4.0f}, {x1, 4.0f}, -1});
+        map.walls.push_back({{x1, 4.0f}, {x1, 0.0f}, -1});
+        map.walls.push_back({{x1, 0.0f}, {x0, 0.0f}, -1});
+        map.sectors.push_back({0.5f, 1.0f, begin, int(map.walls.size()) - 1});
+    };
+    room(0.0f, 4.0f);
+    room(4.25f, 8.25f);
+    map.build();
+    CompactMap compact;
+    compact.build(map, 0);
+
+    MapAnimator animator;
+    animator.bind(map, {{MOVER_SLIDE, 0, {-1.0f, 0.0f}, 1.0f, 0.0f}});
+    animator.apply(map, 1.0);
+    compact.updateSectors(map, map.updatedSectors());
+    CompactMap rebuilt;
+    rebuilt.build(map, 0);
+
+    // From the second room, looking at the wall facing the first
+    Renderer renderer(map.sectors.size());
+    Framebuffer frame(BENCH_WIDTH, BENCH_HEIGHT);
+    Player player{{6, 2, 0}, 3.14159265f};
+    renderer.renderWorld(rebuilt, player, frame);
+    uint64_t rebuilt_hash = frame.hash();
+    renderer.renderWorld(compact, player, frame);
+    if (frame.hash() != rebuilt_hash) {
+        std::cout << "Sliding a sector moved walls of another in the compact layout\n";
+        mismatches++;
+    }
+}
+
+static std::vector<Result> runBenchmarks(const std::string& map_name, const Map& map) {
+    std::vector<Result> results;
+    Player player{{2, 2, 0}, 0};
+
+    // Rays fanning out from inside the first room
+    std::vector<Ray> rays;
+    for (int i = 0; i < 64; i++) {
+        float a = i * 2 * 3.1415f / 64;
+        rays.push_back({{2.0f, 2.0f}, {std::cos(a), std::sin(a)}});
+    }
+
+    results.push_back({"rayIntersect/" + map_name, timeNs([&] {
+        unsigned long long hits = 0;
+        for (const Ray& ray : rays)
+            for (const Wall& wall : map.walls) {
+                float2 point;
+                hits += wall.rayIntersect(ray, &point);
+            }
+        sink = hits;
+    }, rays.size() * map.walls.size())});
+
+    results.push_back({"facingFront/" + map_name, timeNs([&] {
+        unsigned long long front = 0;
+        for (const Ray& ray : rays)
+            for (const Wall& wall : map.walls)
+                front += wall.facingFront(ray);
+        sink = front;
+    }, rays.size() * map.walls.size())});
+
+    // Points spread over the whole map, tested against every sector
+    std::vector<float2> points;
+    for (int i = 0; i < 64; i++)
+        points.push_back({(i + 0.5f) / 64 * map.bounds.back().max.x, 0.5f + (i % 7) * 0.5f});
+    results.push_back({"containsPoint/" + map_name, timeNs([&] {
+        unsigned long long inside = 0;
+        for (float2 point : points)
+            for (const Sector& sector : map.sectors)
+                inside += sector.containsPoint(point, map.walls);
+        sink = inside;
+    }, points.size() * map.sectors.size())});
+
+    Renderer renderer(map.sectors.size());
+    Framebuffer frame(BENCH_WIDTH, BENCH_HEIGHT);
+    int player_sector = map.locateSector(player.pos.xy());
+    results.push_back({"renderColumn/" + map_name, timeNs([&] {
+        renderer.beginFrame(map);
+        renderer.renderColumn(map, player, frame, player_sector, BENCH_WIDTH / 2);
+        sink = frame.pixels[BENCH_WIDTH / 2];
+    }, 1)});
+
+    results.push_back({"frame/" + map_name, timeNs([&] {
+        renderer.renderWorld(map, player, frame);
+        sink = frame.pixels[0];
+    }, 1)});
+
+    // Same frame from the compact layout, which has to give the same image
+    CompactMap compact;
+    compact.build(map);
+    uint64_t full_hash = frame.hash();
+    results.push_back({"frameCompact/" + map_name, timeNs([&] {
+        renderer.renderWorld(compact, player, frame);
+        sink = frame.pixels[0];
+    }, 1)});
+    if (frame.hash() != full_hash) {
+        std::cout << map_name << ": compact layout renders a different image\n";
+        mismatches++;
+    }
+    std::cout << map_name << ": map " << map.memoryBytes() << " bytes, compact " << compact.memoryBytes() << " bytes\n";
+
+    // Interleaved even and odd columns at 60 fps while panning slowly, every frame reuses half the last one
+    Renderer interleaved(map.sectors.size());
+    interleaved.setInterleave({1, DEFAULT_INTERLEAVE_MAX_TURN_RATE, DEFAULT_INTERLEAVE_MAX_SPEED});
+    Player turning = player;
+    double frame_time = 0.0;
+    results.push_back({"frameInterleaved/" + map_name, timeNs([&] {
+        frame_time += 1.0 / 60;
+        turning.angle += 0.001f;
+        interleaved.setFrameTime(frame_time);
+        interleaved.renderWorld(map, turning, frame);
+        sink = frame.pixels[0];
+    }, 1)});
+
+    // Walking back and forth while turning with the keys, both at the engine's
+    // PLAYER_SPEED of 5 units and radians per second, at 60 fps
+    Player walking = player;
+    unsigned long walk_frames = 0, walk_full = 0;
+    results.push_back({"frameInterleavedWalk/" + map_name, timeNs([&] {
+        frame_time += 1.0 / 60;
+        float stride = std::fmod(float(walk_frames) * 5.0f / 60, 2.0f);
+        walking.pos.x = player.pos.x - 0.5f + (stride < 1.0f ? stride : 2.0f - stride);
+        walking.angle += 5.0f / 60;
+        interleaved.setFrameTime(frame_time);
+        interleaved.renderWorld(map, walking, frame);
+        walk_frames++;
+        walk_full += interleaved.lastFrameFull();
+        sink = frame.pixels[0];
+    }, 1)});
+    if (walk_full > walk_frames / 10)
+        std::cout << map_name << ": walking cast every column in " << walk_full << " of " << walk_frames << " frames\n";
+
+    VisibilityQuery query(map.sectors.size());
+    VisibleSet visible;
+    results.push_back({"visible/" + map_name, timeNs([&] {
+        query.query(map, player, BENCH_WIDTH, BENCH_HEIGHT, visible, true);
+        sink = visible.walls.size();
+    }, 1)});
+
+    // Small views from the middle of many sectors, time per view
+    std::vector<Player> cameras;
+    std::vector<Framebuffer> frames(BATCH_CAMERAS, Framebuffer(BATCH_WIDTH, BATCH_HEIGHT));
+    for (int i = 0; i < BATCH_CAMERAS; i++) {
+        const SectorBounds& b = map.bounds[i % map.bounds.size()];
+        float2 center = (b.min + b.max) * 0.5f;
+        cameras.push_back({{center.x, center.y, 0}, i * 0.7f});
+    }
+    BatchRenderer batch(0, map.sectors.size());
+    results.push_back({"batch/" + map_name, timeNs([&] {
+        batch.render(map, cameras.data(), frames.data(), BATCH_CAMERAS);
+        sink = frames[0].pixels[0];
+    }, BATCH_CAMERAS)});
+
+    // Line of sight between sector centres, time per ray
+    std::vector<RaySegment> segments;
+    std::vector<RayHit> hits(BATCH_RAYS);
+    for (int i = 0; i < BATCH_RAYS; i++) {
+        const SectorBounds& a = map.bounds[i % map.bounds.size()];
+        const SectorBounds& b = map.bounds[(i * 7 + 3) % map.bounds.size()];
+        float2 from = (a.min + a.max) * 0.5f, to = (b.min + b.max) * 0.5f + float2(0.3f, 0.2f);
+        segments.push_back({{from.x, from.y, 0.0f}, {to.x, to.y, 0.1f}, int(i % map.bounds.size())});
+    }
+    RayCaster caster(map);
+    results.push_back({"raycast/" + map_name, timeNs([&] {
+        caster.castBatch(segments.data(), hits.data(), BATCH_RAYS);
+        sink = hits[0].type;
+    }, BATCH_RAYS)});
+
+    // Doors, lifts and slides on every fourth sector, time per animation tick
+    Map animated = map;
+    std::vector<Mover> movers;
+    for (int i = 0; i < int(map.sectors.size()); i += 4) {
+        MoverKind kind = MoverKind(i / 4 % 3);
+        movers.push_back({kind, i, kind == MOVER_SLIDE ? float2(0.5f, 0.25f) : float2(1.0f, 0.0f), 1.5f, 0.1f * (i % 20)});
+    }
+    MapAnimator animator;
+    animator.bind(animated, movers);
+    // One full cycle first, every cell a moving sector can reach is in the index after that
+    double animation_time = 0.0;
+    for (int i = 0; i < 3 * 60; i++) {
+        animation_time += 1.0 / 60.0;
+        animator.apply(animated, animation_time);
+    }
+    results.push_back({"animate/" + map_name, timeNs([&] {
+        animation_time += 1.0 / 60.0;
+        sink = animator.apply(animated, animation_time);
+    }, 1)});
+
+    // A still camera with the map animating, interleaved frames have to match full ones
+    // as long as the history is dropped whenever something moved, like the engine does
+    for (int i = 0; i < 30; i++) {
+        animation_time += 1.0 / 60.0;
+        if (animator.apply(animated, animation_time) > 0) interleaved.invalidateHistory();
+        renderer.renderWorld(animated, player, frame);
+        uint64_t still_hash = frame.hash();
+        interleaved.setFrameTime(animation_time);
+        interleaved.renderWorld(animated, player, frame);
+        if (frame.hash() != still_hash) {
+            std::cout << map_name << ": interleaved frames differ from full frames while the map animates\n";
+            mismatches++;
+            break;
+        }
+    }
+
+    // Movers whose every position is a multiple of the compact precision, the compact
+    // layout updated in place has to keep drawing what the Map draws
+    Map moving = map;
+    std::vector<Mover> grid_movers;
+    for (int i = 0; i < int(map.sectors.size()); i += 4) {
+        MoverKind kind = MoverKind(i / 4 % 3);
+        grid_movers.push_back({kind, i, kind == MOVER_SLIDE ? float2(0.5f, 0.25f) : float2(1.0f, 0.0f), 1.0f, 0.25f * (i / 4 % 8)});
+    }
+    MapAnimator grid_animator;
+    grid_animator.bind(moving, grid_movers);
+    CompactMap moving_compact;
+    moving_compact.build(moving);
+    for (int tick = 1; tick <= 16; tick++) {
+        if (grid_animator.apply(moving, tick / 8.0) > 0)
+            moving_compact.updateSectors(moving, moving.updatedSectors());
+        renderer.renderWorld(moving, player, frame);
+        uint64_t moving_hash = frame.hash();
+        renderer.renderWorld(moving_compact, player, frame);
+        if (frame.hash() != moving_hash) {
+            std::cout << map_name << ": compact layout differs from Map after movers\n";
+            mismatches++;
+            break;
+        }
+    }
+
+    return results;
+}
+
+static void writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    file << "{\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        file << "    {\"name\": \"" << results[i].name << "\", \"ns_per_op\": " << results[i].ns_per_op << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+}
+
+// Reads back what writeJson wrote, not a general JSON parser
+static std::map<std::string, double> readJson(const std::string& path) {
+    std::map<std::string, double> results;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t ns = line.find("\"ns_per_op\": ");
+        if (name == std::string::npos || ns == std::string::npos) continue;
+        name += 9;
+        results[line.substr(name, line.find('"', name) - name)] = std::atof(line.c_str() + ns + 13);
+    }
+    return results;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    std::string out_path = "bench.json", baseline_path;
+    double threshold = 10.0;
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--out")            out_path = arguments[i+1];
+        else if (arguments[i] == "--baseline")  baseline_path = arguments[i+1];
+        else if (arguments[i] == "--threshold") threshold = std::atof(arguments[i+1].c_str());
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+
+    std::vector<Result> results;
+    struct BenchMap {
+        const char* name;
+        MapLayout layout;
+        int sectors, walls_per_sector;
+    };
+    const BenchMap maps[] = {
+        {"corridor_4",      LAYOUT_CORRIDOR,    4,      4},
+        {"corridor_64",     LAYOUT_CORRIDOR,    64,     4},
+        {"corridor_1024",   LAYOUT_CORRIDOR,    1024,   4},
+        {"grid_1024",       LAYOUT_GRID,        1024,   8},
+        {"maze_4096",       LAYOUT_MAZE,        4096,   8},
+        {"open_512",        LAYOUT_OPEN,        1,      512},
+    };
+    for (const BenchMap& bench_map : maps) {
+        std::vector<Result> map_results = runBenchmarks(bench_map.name, generatedMap(bench_map.layout, bench_map.sectors, bench_map.walls_per_sector));
+        results.insert(results.end(), map_results.begin(), map_results.end());
+    }
+
+    checkCompactSlide();
+
+    // Performance overlay over a full history, time per draw
+    PerfHud hud;
+    Framebuffer hud_frame(BENCH_WIDTH, BENCH_HEIGHT);
+    for (int i = 0; i < HUD_HISTORY; i++)
+        hud.record({16.0f + i % 7, 3.0f, 0.5f, 1.0f, 1000ul + i, 10ul, i % 2 == 0});
+    results.push_back({"hud", timeNs([&] {
+        hud.draw(hud_frame);
+        sink = hud_frame.pixels[0];
+    }, 1)});
+    writeJson(out_path, results);
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty()) baseline = readJson(baseline_path);
+    // Asked to compare but nothing to compare against fails, the gate would pass without running
+    bool no_baseline = !baseline_path.empty() && baseline.empty();
+
+    int regressions = 0, allocating = 0;
+    for (const Result& result : results) {
+        std::cout << result.name << ": " << result.ns_per_op << " ns";
+        if (result.allocations > 0) {
+            std::cout << " ALLOCATES (" << result.allocations << " allocations)";
+            allocating++;
+        }
+        auto base = baseline.find(result.name);
+        if (base != baseline.end()) {
+            double change = 100.0 * (result.ns_per_op - base->second) / base->second;
+            std::cout << " (" << (change >= 0 ? "+" : "") << change << "%)";
+            if (change > threshold) {
+                std::cout << " REGRESSION";
+                regressions++;
+            }
+        }
+        std::cout << "\n";
+    }
+    if (allocating > 0)
+        std::cout << allocating << " benchmarks allocate after their first run\n";
+    if (regressions > 0)
+        std::cout << regressions << " benchmarks regressed by more than " << threshold << "%\n";
+    if (no_baseline)
+        std::cout << "No baseline in " << baseline_path << ", record one with make bench-baseline or skip the comparison with BENCH_BASELINE=\n";
+    if (allocating > 0 || regressions > 0 || mismatches > 0 || no_baseline) return 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocation counting, compiled in with TRACK_ALLOCATIONS (make ALLOC_TRACKING=1).
+//
+// The global operator new and delete are replaced with versions that count every
+// allocation and its size, in total and for the AllocScope active on the calling
+// thread. Without TRACK_ALLOCATIONS the scopes compile to nothing and the counts stay zero.
+
+const int ALLOC_MAX_SCOPES = 32;
+
+struct AllocCounts {
+    unsigned long long allocations, bytes;
+
+    AllocCounts operator-(const AllocCounts& other) const { return {allocations - other.allocations, bytes - other.bytes}; }
+};
+
+#ifdef TRACK_ALLOCATIONS
+const bool ALLOC_TRACKING = true;
+#else
+const bool ALLOC_TRACKING = false;
+#endif
+
+// Allocations since the program started, from all threads
+AllocCounts allocTotals();
+
+// Attributes allocations on this thread to name until it goes out of scope, scopes
+// nest. name has to stay valid, string literals are the intended use. Names after
+// the first ALLOC_MAX_SCOPES - 1 share one entry.
+class AllocScope {
+public:
+#ifdef TRACK_ALLOCATIONS
+    explicit AllocScope(const char* name);
+    ~AllocScope();
+#else
+    explicit AllocScope(const char*) {}
+#endif
+    // Forbid copy and assignment
+    AllocScope(const AllocScope&) = delete;
+    AllocScope operator=(const AllocScope&) = delete;
+
+private:
+#ifdef TRACK_ALLOCATIONS
+    int previous;
+#endif
+};
+
+// Allocations attributed to a scope so far, zero for names never entered
+AllocCounts allocScopeCounts(const char* name);
+// Prints every scope that allocated, allocations outside any scope count as "unscoped"
+void printAllocScopes();
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Map.h>
+#include <linalg.h>
+#include <string>
+#include <vector>
+
+using namespace linalg::aliases;
+
+enum MoverKind {
+    MOVER_DOOR,     // Raises the ceiling
+    MOVER_LIFT,     // Raises the floor
+    MOVER_SLIDE     // Moves the sector's walls, neighbouring walls that share an endpoint follow
+};
+
+// Moves a sector from its rest position to travel and back over and over
+struct Mover {
+    MoverKind kind;
+    int sector;
+    float2 travel;      // Height in x for doors and lifts, offset for slides
+    float seconds;      // One way
+    float phase;        // 0 to 2, where in the cycle it is at time 0
+};
+
+// Mover file layout: number of movers, then one per line as
+//     door <sector> <height> <seconds> <phase>
+//     lift <sector> <height> <seconds> <phase>
+//     slide <sector> <dx> <dy> <seconds> <phase>
+bool readMoverFile(const std::string& path, std::vector<Mover>& movers);
+
+// Plays movers on a map. The pose only depends on the time, so replays animate the same.
+// Only sectors that actually moved are marked dirty, nothing is rebuilt for the rest.
+class MapAnimator {
+public:
+    MapAnimator() {}
+    // Forbid copy and assignment
+    MapAnimator(const MapAnimator&) = delete;
+    MapAnimator operator=(const MapAnimator&) = delete;
+
+    // Takes the map as it is now as the rest position, call again after the map was reloaded.
+    // Movers with a sector that doesn't exist are dropped.
+    void bind(const Map& map, const std::vector<Mover>& movers);
+
+    // Moves everything to where it is at the given time, marks the moved sectors dirty
+    // and updates the map's derived data. Returns the number of sectors updated.
+    int apply(Map& map, double seconds);
+
+    int moverCount() const { return movers.size(); }
+
+private:
+    // A wall endpoint moved by a slide
+    struct SlideEnd {
+        int wall;
+        bool second;    // p2 instead of p1
+        float2 rest;
+    };
+
+    std::vector<Mover> movers;
+    std::vector<float> rest_heights;    // Per mover, floor or ceiling at rest
+    std::vector<float> positions;       // Per mover, 0 at rest to 1 at travel, as last applied
+    // The endpoints mover i slides are slide_ends[slide_begin[i]] up to slide_ends[slide_begin[i + 1]]
+    std::vector<int> slide_begin;
+    std::vector<SlideEnd> slide_ends;
+    // The sectors those endpoints belong to, each once, the same way
+    std::vector<int> dirty_begin;
+    std::vector<int> dirty_sectors;
+};
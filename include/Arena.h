@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Bump allocator for data that only lives for one frame. Memory is reserved up
+// front and handed out linearly, reset() makes all of it available again
+// without freeing anything. Only meant for trivially destructible types.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity) : memory(capacity), used(0) {}
+
+    // Returns nullptr when the arena is full
+    template<class T> T* alloc(size_t count) {
+        size_t begin = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (begin + count * sizeof(T) > memory.size()) return nullptr;
+        used = begin + count * sizeof(T);
+        return reinterpret_cast<T*>(memory.data() + begin);
+    }
+
+    void reset() { used = 0; }
+    // Grows the arena, invalidates everything allocated from it
+    void reserve(size_t capacity) {
+        if (capacity > memory.size()) memory.resize(capacity);
+        used = 0;
+    }
+    size_t capacity() const { return memory.size(); }
+    size_t size() const { return used; }
+
+private:
+    std::vector<unsigned char> memory;
+    size_t used;
+};
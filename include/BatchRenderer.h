@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Renderer.h>
+#include <WorkerPool.h>
+#include <Map.h>
+#include <Player.h>
+#include <Framebuffer.h>
+#include <vector>
+
+// Renders many views of one map in a single call, for bots and offline work.
+// The map is only read, every thread has its own Renderer. Does not need SDL.
+class BatchRenderer {
+public:
+    // threads = 0 uses one thread per hardware thread, the calling thread counts as one
+    explicit BatchRenderer(int threads = 0, int max_portal_depth = DEFAULT_MAX_PORTAL_DEPTH);
+
+    // Renders cameras[i] into frames[i] for every i < count and returns when all are done.
+    // Frames may have different sizes, a camera outside the map leaves its frame untouched.
+    // The map must not change during the call.
+    void render(const Map& map, const Player* cameras, Framebuffer* frames, int count);
+
+    int threadCount() const { return pool.threadCount(); }
+
+private:
+    // Cameras are handed out in chunks to keep contention on the counter low
+    static const int CHUNK = 4;
+
+    WorkerPool pool;
+    std::vector<Renderer> renderers;    // One per pool thread
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Map.h>
+#include <Sector.h>
+#include <linalg.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace linalg::aliases;
+
+const int DEFAULT_COMPACT_PRECISION_BITS = 8;
+
+// Read only copy of a map laid out for size, for worlds with millions of sectors.
+//
+// Walls index into a pool of vertices instead of storing both endpoints, walls
+// whose endpoints are the same point share one.
+// Vertices are rounded to multiples of 2^-precision_bits and stored as 16 bit
+// offsets from the map's corner when the map is small enough, 32 bit otherwise.
+// Portals use 16 bit sector indices when there are fewer than 65535 sectors.
+//
+// What the portal walk reads for every wall (vertex indices and vertices) is
+// kept apart from what it reads once per step (portals, heights) and from what
+// it never reads (bounds, lighting). A map whose coordinates are all multiples
+// of the precision renders exactly like the Map it was built from.
+class CompactMap {
+public:
+    CompactMap();
+
+    // Builds the compact layout of map, precision_bits goes up to 16.
+    // Returns false if a sector has more than 65535 walls.
+    bool build(const Map& map, int precision_bits = DEFAULT_COMPACT_PRECISION_BITS);
+
+    // Copies heights and wall endpoints of the given sectors from the map it was built from,
+    // walls only for sectors with DIRTY_WALLS in map.updatedFlags(). Moved vertices are
+    // rounded in place, into the range the layout can hold.
+    void updateSectors(const Map& map, const std::vector<int>& ids);
+
+    // Same accessors as Map, so code can be written once for both layouts
+    int sectorCount() const { return sectors.size(); }
+    int wallsBegin(int sector) const { return sectors[sector].walls_begin; }
+    int wallsEnd(int sector) const { return sectors[sector].walls_begin + sectors[sector].wall_count - 1; }
+    float sectorFloor(int sector) const { return heights[sector].x; }
+    float sectorCeil(int sector) const { return heights[sector].y; }
+    // Geometry only, next_sector is -1. Walls are tested in the inner loop and the portal
+    // array is only worth reading after a hit, through nextSector().
+    Wall wall(int id) const { return Wall{vertex(wall_vertices[id].v1), vertex(wall_vertices[id].v2), -1}; }
+    float2 wallEdge(int id) const { return vertex(wall_vertices[id].v2) - vertex(wall_vertices[id].v1); }
+    int nextSector(int wall) const {
+        if (!portals16.empty()) return portals16[wall] == NO_SECTOR16 ? -1 : portals16[wall];
+        return portals32[wall];
+    }
+    float2 vertex(uint32_t id) const {
+        if (!vertices16.empty()) return origin + float2(vertices16[id].x, vertices16[id].y) * step;
+        return origin + float2(vertices32[id]) * step;
+    }
+
+    // Returns the sector containing the point, or -1
+    int locateSector(float2 point) const;
+    bool containsPoint(int sector, float2 point) const;
+
+    MapLighting lighting;
+    bool lit() const {
+        return !lighting.empty() && lighting.walls.size() == wall_vertices.size()
+            && lighting.floors.size() == sectors.size() && lighting.ceils.size() == sectors.size();
+    }
+
+    int vertexCount() const { return vertices16.empty() ? vertices32.size() : vertices16.size(); }
+    // Largest distance a vertex moved when it was rounded
+    float maxError() const { return max_error; }
+    bool narrowVertices() const { return !vertices16.empty(); }
+    bool narrowPortals() const { return !portals16.empty(); }
+    // Bytes held by the layout, including the spatial index
+    size_t memoryBytes() const;
+
+private:
+    static const uint16_t NO_SECTOR16 = 0xffff;
+
+    struct SectorRange {
+        uint32_t walls_begin;
+        uint16_t wall_count;
+    };
+    struct WallVertices {
+        uint32_t v1, v2;
+    };
+    struct Vertex16 {
+        uint16_t x, y;
+    };
+
+    // Hot, read for every wall a ray tests
+    std::vector<SectorRange> sectors;
+    std::vector<WallVertices> wall_vertices;
+    std::vector<Vertex16> vertices16;       // One of the two vertex pools is used
+    std::vector<int2> vertices32;
+    float2 origin;
+    float step;
+
+    // Warm, read once per portal step
+    std::vector<uint16_t> portals16;        // One of the two portal lists is used
+    std::vector<int32_t> portals32;
+    std::vector<float2> heights;            // Per sector, floor and ceiling
+
+    // Cold, only for locating the player
+    std::vector<SectorBounds> bounds;
+    // Uniform grid of MAP_CELL_SIZE cells over the map, the sectors of cell i
+    // are cell_sectors[cell_start[i]] up to cell_sectors[cell_start[i + 1]]
+    int2 grid_min, grid_size;
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_sectors;
+    // Sectors whose walls moved since the index was built, with where they are now
+    struct MovedSector {
+        int id;
+        SectorBounds bounds;
+    };
+    std::vector<MovedSector> moved;
+    std::vector<int> moved_slots;           // Per sector, index into moved or -1, empty until something moved
+
+    float max_error;
+
+    // Nearest multiple of step, relative to origin
+    int2 quantize(float2 p) const;
+    void buildIndex();
+};
@@ -1,32 +1,74 @@
 #pragma once
 
-#include <util.h>
+#include <Window.h>
+#include <Framebuffer.h>
+#include <Player.h>
 #include <Sector.h>
+#include <Map.h>
+#include <CompactMap.h>
+#include <Animation.h>
+#include <FileWatcher.h>
+#include <Replay.h>
+#include <Renderer.h>
+#include <FramePipeline.h>
+#include <FrameCapture.h>
+#include <PerfHud.h>
+#include <AllocTracker.h>
 #include <vector>
+#include <memory>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
+#include <cstring>
 #include <string>
 
-const float FOV                 = 90 * 3.1415f / 180.0f;
 const float PLAYER_SPEED        = 5.0f;
 const float MOUSE_SENSITIVITY   = 0.001f;
+// How often the debug views may change the window title
+const int DEBUG_TITLE_UPDATES_PER_SECOND = 4;
 
 using namespace linalg::aliases;
 
-struct Player {
-     float3 pos;
-     float angle;
-};
-
 class Engine {
 public:
-    Engine(unsigned int width, unsigned int height);
+    // A headless engine has no window, it only renders into its framebuffer
+    Engine(unsigned int width, unsigned int height, const std::string& map_path = "map", bool headless = false);
     ~Engine();
     // Forbid copy and assignment
     Engine(const Engine&) = delete;
     Engine operator=(const Engine&) = delete;
 
+    // Input recording and replay, call before the first frame
+    bool record(const std::string& path);
+    // Replays recorded input with the recorded dt, or with fixed_dt if it's above zero.
+    // Per-frame timings and framebuffer hashes are written to timing_path.
+    bool replay(const std::string& path, const std::string& timing_path, double fixed_dt = 0.0);
+
+    // How many frames may be rendered ahead of the one being presented, 0 renders and presents in turn.
+    // Call before the first frame.
+    void setFramesInFlight(int frames);
+
+    // Limits how many portals a column may pass through
+    void setMaxPortalDepth(int depth) { renderer.setMaxPortalDepth(depth); }
+
+    // Casts only every other block of columns per frame and keeps the rest, see InterleaveSettings.
+    // 0 casts every column.
+    void setInterleave(int block);
+
+    // Renders the fps view from a compact copy of the map with vertices rounded to
+    // multiples of 2^-precision_bits, and prints the memory used by both layouts
+    void useCompactMap(int precision_bits);
+
+    // Plays the doors, lifts and sliding walls of a mover file, returns false if it can't be read
+    bool loadMovers(const std::string& path);
+
+    // Shows the performance overlay, F2 toggles it
+    void showHud(bool show) { hud_visible = show; }
+
+    // Streams every presented frame to a file or pipe, see FrameCapture. Returns false if it can't be opened.
+    bool capture(const std::string& path, CaptureFormat format, int fps);
+
     // Main loop
     void startFrame();
     void events();
@@ -38,12 +80,20 @@ private:
 
     // Game states/menus
     enum State {    // Once more states are implemented, use a std::map to create a finite state machine. (sounds cool)
-        WORLD, MAP
+        WORLD, MAP,
+        OVERDRAW,   // Debug, pixels coloured by how often they were drawn
+        COST        // Debug, columns coloured by walls tested with a bar for portals crossed
     };
 
     // Window variables
     int window_width, window_height;
-    Window main_window;
+    std::unique_ptr<Window> main_window;
+    Renderer renderer;          // Only used from the render stage
+    RenderStats render_stats;   // Same
+    RenderStats hud_stats;      // Same, only the totals
+    bool debug_title;
+    char debug_title_text[128]; // Title last set by the debug views
+    Uint64 debug_title_time;    // Performance counter when it was set
 
     // Time variables
     Uint64 time_init;
@@ -57,16 +107,74 @@ private:
     State current_state;
     float map_zoom;
 
-    // Map data
-    std::vector<Wall> walls;
-    std::vector<Sector> sectors;
+    // Everything the render stage reads, copied when the frame is submitted
+    struct FrameState {
+        Player player;
+        State state;
+        float map_zoom;
+        Uint64 input_time;  // Performance counter when the frame's input was read
+        double animation_time;
+        bool hud;           // Count walls and portals for the overlay
+        float event_ms;     // Input and simulation time of the frame
+        // Written by the render stage in the debug states and for the overlay
+        float overdraw;
+        unsigned long walls_tested, portals_crossed;
+        bool partial;       // Interleaved frame, the overlay's counts only cover the columns cast
+    };
+    std::unique_ptr<FramePipeline> pipeline;
+    std::vector<FrameState> frame_states;   // One per pipeline slot
+    unsigned long presented_frames;
+    double latency_total_seconds, latency_max_seconds;
+
+    // Performance overlay, drawn over the frame when it's presented
+    PerfHud hud;
+    bool hud_visible;
+    Uint64 events_start, last_present;
+    float event_ms, present_ms;
+
+    // Heap allocations per frame, counted with ALLOC_TRACKING after the first ALLOC_WARMUP_FRAMES
+    static const unsigned long ALLOC_WARMUP_FRAMES = 60;
+    unsigned long frames_started, allocating_frames;
+    AllocCounts frame_allocs, steady_allocs;
+
+    // Map data, reloaded whenever the map file changes
+    std::string map_path;
+    Map map;
+    FileWatcher map_watcher;
+    CompactMap compact_map;     // Rebuilt with the map when compact_precision is 0 or above
+    int compact_precision;
+
+    // Moving sectors. The clock advances in update(), the render stage moves the map
+    // to the frame's time before drawing, so only that thread ever writes the map.
+    std::vector<Mover> movers;
+    MapAnimator animator;
+    double animation_time;
+
+    // Input for the current frame, live or replayed
+    InputFrame input;
+    InputRecorder recorder;
+    InputReplay replayer;
+    double replay_fixed_dt;
+    std::ofstream timing_log;
+    unsigned long replay_frames;
+    double replay_render_seconds;
+    uint64_t replay_hash;
+
+    // Copies presented frames for the writer thread
+    FrameCapture frame_capture;
+
+    InputFrame pollInput();
+    void applyInput();
+    void finishReplay();
+    void buildCompactMap();
+    void renderFrame(int slot, Framebuffer& frame);
+    void presentFrame(int slot, Framebuffer& frame, double render_seconds);
 
     // Rendering functions
-    void renderMap();       // Renders the map view
-    void renderWorld();     // Renders the fps view
-    // Renders each column with recursively to determine visible sectors and draw them
-    void renderSector(const Sector& sector, int col, Ray camera_ray, float radians);
+    void renderWorld(const Player& player, Framebuffer& frame);    // Fps view from the map layout in use, compact or not
+    void renderMap(const FrameState& state, Framebuffer& frame);   // Renders the map view, the fps view is drawn by the renderer
+    void renderCost(FrameState& state, Framebuffer& frame);        // Renders the debug states
 
     // Helper
-    int2 worldToMap(float2 world_coords);
+    int2 worldToMap(const FrameState& state, float2 world_coords);
 };
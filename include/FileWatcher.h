@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+// Watches a single file for changes with inotify. The containing directory is
+// watched rather than the file itself, since most editors save by replacing the file.
+class FileWatcher {
+public:
+    FileWatcher(const std::string& path);
+    ~FileWatcher();
+    // Forbid copy and assignment
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher operator=(const FileWatcher&) = delete;
+
+    // Non-blocking, returns true if the file was written since the last call
+    bool changed();
+
+private:
+    int fd, wd;
+    std::string file_name;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Framebuffer.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum CaptureFormat {
+    CAPTURE_Y4M,    // YUV 4:2:0, BT.601 limited range, plays in ffmpeg, mpv and most editors
+    CAPTURE_RGBA    // Raw R, G, B, A bytes per pixel, no header
+};
+
+// Parses "y4m" or "rgba", returns false for anything else
+bool parseCaptureFormat(const std::string& name, CaptureFormat& format);
+
+// Streams frames to a file or pipe on a writer thread.
+//
+// push() trades the frame's pixels for one of a fixed number of buffers allocated up
+// front and returns, converting and writing happen on the writer thread. When every buffer
+// is still waiting to be written the frame is dropped and counted rather than
+// stalling the caller. Only the writer thread writes, with SIGPIPE blocked, so a
+// consumer that goes away just stops the capture.
+class FrameCapture {
+public:
+    FrameCapture();
+    ~FrameCapture();
+    // Forbid copy and assignment
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture operator=(const FrameCapture&) = delete;
+
+    // path is a file, "-" for stdout or "|command" to pipe into a command. fps only goes into the Y4M header.
+    // Returns false if the output can't be opened.
+    bool open(const std::string& path, int width, int height, CaptureFormat format, int fps = 60, int buffers = 8);
+    // Writes out the frames still queued and closes the output
+    void close();
+    bool active() const { return out != nullptr; }
+
+    // Queues the frame, returns false if it was dropped. A framebuffer that owns its pixels
+    // gets a free buffer in exchange for them and holds stale pixels afterwards, other
+    // framebuffers are copied.
+    bool push(Framebuffer& frame);
+
+    unsigned long framesWritten() const { return written - lost; }
+    unsigned long framesDropped() const { return dropped + lost; }
+    // Prints frames written and dropped, and the time spent on the caller's and the writer's side
+    void printStats() const;
+
+private:
+    FILE* out;
+    bool piped;
+    int width, height;
+    CaptureFormat format;
+
+    // Ring of frame copies, frame i goes into buffer i % buffers.size()
+    std::vector<std::vector<uint32_t>> buffers;
+    std::vector<uint8_t> converted;     // Writer thread only
+    std::string header;                 // Written by the writer thread before the first frame
+    // written counts frames the writer took, lost those of them that failed to write
+    unsigned long pushed, written, dropped, lost;
+    bool stopping, failed;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread writer;
+
+    double push_seconds, write_seconds;
+
+    void writeLoop();
+    // Converts into converted, returns the number of bytes to write
+    size_t convert(const uint32_t* pixels);
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Framebuffer.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Renders frames on a worker thread while the calling thread presents earlier ones.
+//
+// There are frames_in_flight + 1 framebuffers. After present() returns, at most
+// frames_in_flight submitted frames haven't been presented yet, which bounds the
+// added latency to that many frames. With zero frames in flight frames are
+// rendered on the calling thread inside submit() and no thread is started.
+class FramePipeline {
+public:
+    // Called on the render thread with the slot passed to submit and its framebuffer
+    using RenderFunc = std::function<void(int slot, Framebuffer& frame)>;
+
+    FramePipeline(int width, int height, int frames_in_flight, RenderFunc render);
+    ~FramePipeline();
+    // Forbid copy and assignment
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline operator=(const FramePipeline&) = delete;
+
+    // Slot the next submitted frame will use, per-frame data for the render function can be stored under it
+    int nextSlot() const { return submitted % slots.size(); }
+    int slotCount() const { return slots.size(); }
+    int framesInFlight() const { return frames_in_flight; }
+
+    void submit();
+
+    // Presents frames until no more than frames_in_flight are waiting.
+    // present(int slot, Framebuffer& frame, double render_seconds), it may take the
+    // pixels with Framebuffer::swapPixels, the next frame in the slot is drawn over them.
+    template<class F> void present(F present_func) { presentUntil(frames_in_flight, present_func); }
+    // Presents every submitted frame
+    template<class F> void flush(F present_func) { presentUntil(0, present_func); }
+    // Blocks until the render thread is idle, so shared data can be changed
+    void wait();
+
+private:
+    struct Slot {
+        Framebuffer frame;
+        double render_seconds;
+    };
+
+    int frames_in_flight;
+    RenderFunc render;
+    std::vector<Slot> slots;
+    // Frame counters, slot of frame i is i % slots.size()
+    unsigned long submitted, rendered, presented;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread worker;
+
+    void renderLoop();
+    double renderSlot(int slot);
+
+    template<class F> void presentUntil(unsigned long max_waiting, F present_func) {
+        while (submitted - presented > max_waiting) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] { return rendered > presented; });
+            }
+            int slot = presented % slots.size();
+            present_func(slot, slots[slot].frame, slots[slot].render_seconds);
+            std::lock_guard<std::mutex> lock(mutex);
+            presented++;
+        }
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <util.h>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+// Software render target, 32-bit ARGB pixels in rows. Either owns its pixels or
+// draws into memory provided by the caller, which has to outlive it.
+struct Framebuffer {
+    int width, height;
+    uint32_t* pixels;
+
+    Framebuffer(int width, int height) : width(width), height(height), storage(width * height, 0) {
+        pixels = storage.data();
+    }
+    Framebuffer(int width, int height, uint32_t* memory) : width(width), height(height), pixels(memory) {}
+    Framebuffer(const Framebuffer& other) : width(other.width), height(other.height), storage(other.storage) {
+        pixels = storage.empty() ? other.pixels : storage.data();
+    }
+    Framebuffer& operator=(const Framebuffer& other) {
+        width = other.width;
+        height = other.height;
+        storage = other.storage;
+        pixels = storage.empty() ? other.pixels : storage.data();
+        return *this;
+    }
+
+    size_t size() const { return size_t(width) * height; }
+
+    // Exchanges the pixels with a buffer of the same size, without copying. Only for
+    // framebuffers that own their pixels, returns false and does nothing otherwise.
+    bool swapPixels(std::vector<uint32_t>& other) {
+        if (storage.empty() || other.size() != storage.size()) return false;
+        storage.swap(other);
+        pixels = storage.data();
+        return true;
+    }
+
+    static uint32_t pack(RGBA clr) {
+        return uint32_t(clr.a) << 24 | uint32_t(clr.r) << 16 | uint32_t(clr.g) << 8 | uint32_t(clr.b);
+    }
+
+    void clear(RGBA clr) {
+        std::fill(pixels, pixels + size(), pack(clr));
+    }
+
+    // Vertical line including both ends, clipped to the framebuffer
+    void drawColumn(int x, int y1, int y2, RGBA clr) {
+        if (x < 0 || x >= width) return;
+        if (y1 > y2) std::swap(y1, y2);
+        y1 = std::max(y1, 0);
+        y2 = std::min(y2, height - 1);
+        if (y1 > y2) return;
+        uint32_t c = pack(clr);
+        for (uint32_t* p = &pixels[y1 * width + x], *end = p + (y2 - y1 + 1) * width; p < end; p += width)
+            *p = c;
+    }
+
+    // Bresenham line including both ends, clipped per pixel
+    void drawLine(int x1, int y1, int x2, int y2, RGBA clr) {
+        uint32_t c = pack(clr);
+        int dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+        int dy = -std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+        int err = dx + dy;
+        while (true) {
+            if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height) pixels[y1 * width + x1] = c;
+            if (x1 == x2 && y1 == y2) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x1 += sx; }
+            if (e2 <= dx) { err += dx; y1 += sy; }
+        }
+    }
+
+    // FNV-1a over the pixels, used to compare frames between builds
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ull;
+        for (const uint32_t* it = pixels; it < pixels + size(); it++) {
+            uint32_t p = *it;
+            h = (h ^ (p & 0xff)) * 1099511628211ull;
+            h = (h ^ (p >> 8 & 0xff)) * 1099511628211ull;
+            h = (h ^ (p >> 16 & 0xff)) * 1099511628211ull;
+            h = (h ^ (p >> 24)) * 1099511628211ull;
+        }
+        return h;
+    }
+
+private:
+    std::vector<uint32_t> storage;  // Empty when the memory belongs to the caller
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Map.h>
+#include <linalg.h>
+#include <string>
+#include <vector>
+
+using namespace linalg::aliases;
+
+struct PointLight {
+    float3 pos;
+    float intensity;    // Light level added right next to the light
+    float radius;       // Falls off linearly to nothing at this distance
+};
+
+struct BakeParams {
+    int samples;        // Per wall along its length and height, per floor and ceiling along each axis
+    float ambient;      // Level every surface gets regardless of lights
+    int threads;        // 0 uses every hardware thread
+};
+
+// Light file layout: number of lights, then "x y z intensity radius" per line
+bool readLightFile(const std::string& path, std::vector<PointLight>& lights);
+
+// Computes light levels for every wall, floor and ceiling of the map. Every
+// sample point checks each light in range for occlusion with a portal raycast.
+void bakeLighting(const Map& map, const std::vector<PointLight>& lights, const BakeParams& params, MapLighting& lighting);
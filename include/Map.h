@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Sector.h>
+#include <linalg.h>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+using namespace linalg::aliases;
+
+// Size of a spatial index cell in world units
+const float MAP_CELL_SIZE = 4.0f;
+
+struct SectorBounds {
+    float2 min, max;
+
+    bool containsPoint(float2 point) const {
+        return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y;
+    }
+};
+
+// Baked light levels from 0 to 1, all empty for a map that hasn't been baked
+struct MapLighting {
+    std::vector<float> walls;   // per wall
+    std::vector<float> floors;  // per sector
+    std::vector<float> ceils;   // per sector
+
+    bool empty() const { return walls.empty(); }
+};
+
+// Reads the wall and sector lists of a map file, returns false if it can't be opened.
+// Lighting is optional and follows the sectors, older readers stop before it.
+bool readMapFile(const std::string& path, std::vector<Wall>& walls, std::vector<Sector>& sectors, MapLighting* lighting = nullptr);
+// Writes them back in the same format, returns false if the file can't be written
+bool writeMapFile(const std::string& path, const std::vector<Wall>& walls, const std::vector<Sector>& sectors, const MapLighting* lighting = nullptr);
+
+// What changed about a sector since derived data was last updated
+enum DirtyFlags {
+    DIRTY_HEIGHTS   = 1 << 0,   // floor or ceiling moved, nothing in the map depends on it
+    DIRTY_WALLS     = 1 << 1    // wall endpoints moved, edges, bounds and the spatial index follow
+};
+
+// Map data plus everything derived from it. Derived data is kept per sector so
+// that a reload only has to touch the sectors whose walls actually changed.
+struct Map {
+    std::vector<Wall> walls;
+    std::vector<Sector> sectors;
+    MapLighting lighting;
+
+    // Derived data
+    std::vector<SectorBounds> bounds;   // per sector
+    std::vector<float2> wall_edges;     // per wall, p2 - p1
+
+    // Full load, throws away everything. Fails on maps with validateMap errors.
+    bool load(const std::string& path);
+    // Rebuilds all derived data from walls and sectors
+    void build();
+    // Incremental load, returns the number of sectors rebuilt or -1 if the file couldn't be
+    // read or has validateMap errors, in which case the map is left as it was
+    int reload(const std::string& path);
+
+    // Returns the sector containing the point, or -1
+    int locateSector(float2 point) const;
+
+    // Moving sectors write walls and heights directly, then mark the sector dirty.
+    // updateDirty() recomputes derived data for the dirty sectors only and returns how many there were.
+    void markDirty(int sector, int flags);
+    int updateDirty();
+    // Sectors the last updateDirty() touched and what changed about them, for caches built on top of the map
+    const std::vector<int>& updatedSectors() const { return updated; }
+    int updatedFlags(int sector) const { return updated_flags[sector]; }
+    // Bumped whenever a sector changes through a reload or updateDirty()
+    uint32_t sectorVersion(int sector) const { return versions[sector]; }
+
+    // Accessors shared with CompactMap, so code can be written once for both layouts
+    int sectorCount() const { return sectors.size(); }
+    int wallsBegin(int sector) const { return sectors[sector].walls_begin; }
+    int wallsEnd(int sector) const { return sectors[sector].walls_end; }
+    float sectorFloor(int sector) const { return sectors[sector].floor; }
+    float sectorCeil(int sector) const { return sectors[sector].ceil; }
+    const Wall& wall(int id) const { return walls[id]; }
+    float2 wallEdge(int id) const { return wall_edges[id]; }
+    int nextSector(int wall) const { return walls[wall].next_sector; }
+
+    // Bytes held by the map and its derived data, including the spatial index
+    size_t memoryBytes() const;
+    // True if there are baked light levels for every wall and sector
+    bool lit() const {
+        return !lighting.empty() && lighting.walls.size() == walls.size()
+            && lighting.floors.size() == sectors.size() && lighting.ceils.size() == sectors.size();
+    }
+
+private:
+    // Spatial index, cell key -> ids of the sectors overlapping the cell
+    std::unordered_map<long long, std::vector<int>> cells;
+    // Dirty tracking, flags per sector and the list of sectors with any flag set
+    std::vector<uint8_t> dirty_flags, updated_flags;
+    std::vector<int> dirty, updated;
+    std::vector<uint32_t> versions;
+
+    void buildSector(int id);
+    void buildBounds(int id);
+    // Cells a sector with these bounds is indexed in, min x, min y, max x, max y
+    static int4 cellRange(const SectorBounds& b);
+    void indexSector(int id);
+    // Removes the sector from the cells covered by b, its bounds when it was indexed
+    void unindexSector(int id, const SectorBounds& b);
+    static long long cellKey(int cx, int cy);
+};
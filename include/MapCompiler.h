@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Map.h>
+#include <Sector.h>
+#include <string>
+#include <vector>
+
+// One problem found in a map, wall is -1 when it's about the whole sector
+struct MapDiagnostic {
+    bool error;         // Errors break rendering or portals, warnings are suspicious but harmless
+    int sector;
+    int wall;
+    std::string message;
+};
+
+// Checks that wall ranges are inside the wall list, don't overlap and cover every
+// wall, that every sector's walls join up into one closed loop and wind clockwise (y up, what Wall::facingFront expects), and
+// that every portal has a wall in the other sector leading back. Returns the number of errors.
+int validateMap(const std::vector<Wall>& walls, const std::vector<Sector>& sectors, std::vector<MapDiagnostic>& diagnostics);
+
+enum SectorOrder {
+    ORDER_BFS,          // Breadth first through portals, starting at sector 0
+    ORDER_HILBERT       // Sector centres along a Hilbert curve over the map
+};
+
+bool parseSectorOrder(const std::string& name, SectorOrder& order);
+
+// Sector ids in the given order, order[new id] = old id
+std::vector<int> sectorOrder(const std::vector<Wall>& walls, const std::vector<Sector>& sectors, SectorOrder order);
+
+// Renumbers sectors as order[new id] = old id. Walls are laid out in the new sector
+// order, keeping their order within a sector, and portals and lighting follow. Walls
+// that belong to no sector are dropped, validateMap reports them as errors.
+void reorderMap(const std::vector<int>& order, std::vector<Wall>& walls, std::vector<Sector>& sectors, MapLighting* lighting = nullptr);
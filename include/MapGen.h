@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Sector.h>
+#include <string>
+#include <vector>
+
+enum MapLayout {
+    LAYOUT_GRID,        // Rectangular grid of rooms, neighbours joined with portal_density probability
+    LAYOUT_MAZE,        // Grid with a spanning tree of portals plus extra ones with portal_density probability
+    LAYOUT_CORRIDOR,    // A single row of rooms, every one joined to the next
+    LAYOUT_OPEN         // One round sector with walls_per_sector walls, sectors is ignored
+};
+
+struct MapGenParams {
+    MapLayout layout;
+    int sectors;
+    int walls_per_sector;   // Rooms get this many walls rounded down to a multiple of 4
+    float portal_density;   // 0 to 1
+    unsigned int seed;
+    float room_size;        // Side length of a room in world units
+};
+
+// Same parameters and seed give the same map on every platform
+void generateMap(const MapGenParams& params, std::vector<Wall>& walls, std::vector<Sector>& sectors);
+
+bool parseLayout(const std::string& name, MapLayout& layout);
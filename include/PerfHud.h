@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Framebuffer.h>
+#include <util.h>
+#include <array>
+
+// Frames the HUD keeps for its graph and percentiles
+const int HUD_HISTORY = 240;
+
+// Timings of one presented frame, all in milliseconds
+struct FrameTimes {
+    float frame_ms;     // From the previous present to this one
+    float render_ms;    // Render stage, on the pipeline's thread
+    float event_ms;     // Input and simulation on the main thread
+    float present_ms;   // Uploading and presenting the previous frame
+    unsigned long walls_tested, portals_crossed;
+    bool partial;       // Interleaved, the counts only cover the columns cast this frame
+};
+
+// Draws text with the built-in 3x5 pixel font, scaled up by scale. Lower case
+// is drawn as upper case, characters without a glyph as blanks. Returns the x after the text.
+int drawText(Framebuffer& frame, int x, int y, const char* text, RGBA clr, int scale = 2);
+
+// Performance overlay in the top left corner of the frame: a rolling graph of
+// frame times, their percentiles over the graph, the split of the last frame
+// and the portal walk counters, marked when they only cover half the columns.
+// Keeps a fixed history, never allocates.
+class PerfHud {
+public:
+    PerfHud();
+
+    void record(const FrameTimes& times);
+    void draw(Framebuffer& frame);
+    // Time the last draw() took, shown on the overlay itself
+    float drawMs() const { return draw_ms; }
+
+private:
+    std::array<FrameTimes, HUD_HISTORY> history;
+    int count, next;    // Frames recorded, capped at HUD_HISTORY, and where the next one goes
+    float draw_ms;
+};
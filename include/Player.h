@@ -0,0 +1,10 @@
+#pragma once
+
+#include <linalg.h>
+
+using namespace linalg::aliases;
+
+struct Player {
+     float3 pos;
+     float angle;
+};
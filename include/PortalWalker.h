@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Map.h>
+#include <CompactMap.h>
+#include <Player.h>
+#include <vector>
+#include <cstdint>
+
+const float FOV                     = 90 * 3.1415f / 180.0f;
+const int DEFAULT_MAX_PORTAL_DEPTH  = 64;
+
+// One sector on the way from the camera to the first solid wall
+struct PortalStep {
+    int sector;
+    int wall;       // closest wall hit in the sector, or -1
+    float dist;     // flat distance to that wall
+};
+
+// Angle of the camera ray for a column of a width x height view
+inline float columnAngle(const Player& player, int col, int width, int height) {
+    return player.angle + atan(width/height * FOV * float(col-width/2) / float(width/2));
+}
+
+// Follows camera rays through portals. Shared by rendering and visibility
+// queries so both see exactly the same sectors. Not thread safe, use one per thread.
+class PortalWalker {
+public:
+    PortalWalker() : visit_stamp(0) {}
+
+    // Sizes the visit stamps for the map, only allocates when the sector count changed
+    void prepare(const Map& map) { prepare(map.sectorCount()); }
+    void prepare(const CompactMap& map) { prepare(map.sectorCount()); }
+
+    // Walks the ray at the given angle from sector_id until a solid wall, a sector this
+    // ray already entered, or max_depth portals. Fills steps[0] to steps[depth] and returns depth.
+    int walk(const Map& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps);
+    int walk(const CompactMap& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps);
+
+private:
+    std::vector<uint32_t> visited;  // Per sector, stamp of the last ray that entered it
+    uint32_t visit_stamp;
+
+    void prepare(int sector_count);
+    // Both layouts share one implementation
+    template<class M> int walkRay(const M& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps);
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Map.h>
+#include <WorkerPool.h>
+#include <linalg.h>
+#include <vector>
+
+using namespace linalg::aliases;
+
+// A 3D segment to trace, sector is the one containing from or -1 to look it up
+struct RaySegment {
+    float3 from, to;
+    int sector;
+};
+
+enum HitType {
+    HIT_NONE,       // Reached the end of the segment, the two ends can see each other
+    HIT_WALL,       // A solid wall, or the step above or below a portal
+    HIT_FLOOR,
+    HIT_CEILING,
+    HIT_OUTSIDE     // The segment doesn't start inside the map
+};
+
+struct RayHit {
+    HitType type;
+    int sector;     // Sector the hit is in
+    int wall;       // Wall that was hit, -1 unless type is HIT_WALL
+    float3 point;
+    float distance; // From the start of the segment
+};
+
+// Hitscan and line of sight traces that walk through portals. A sector spans
+// heights -floor to ceil, the same way the renderer draws it.
+//
+// Keeps a copy of the walls laid out for SIMD, call rebuild() after the map changed
+// or update() after only some sectors did.
+// Tracing only reads, so single traces may run on any number of threads.
+class RayCaster {
+public:
+    // threads = 0 uses one thread per hardware thread for castBatch
+    explicit RayCaster(const Map& map, int threads = 0);
+
+    void rebuild();
+    // Refreshes the walls of the given sectors only, pass Map::updatedSectors() after movers ran
+    void update(const std::vector<int>& sectors);
+
+    RayHit cast(const RaySegment& ray) const;
+    bool lineOfSight(float3 from, float3 to, int sector = -1) const {
+        return cast(RaySegment{from, to, sector}).type == HIT_NONE;
+    }
+    // Traces rays[i] into hits[i] for every i < count, spread over the pool
+    void castBatch(const RaySegment* rays, RayHit* hits, int count);
+    // The pool castBatch uses, free for other work between batches
+    WorkerPool& workerPool() { return pool; }
+
+private:
+    static const int CHUNK = 64;
+
+    const Map& map;
+    WorkerPool pool;
+    // Wall start points and edges, one array per component
+    std::vector<float> x1, y1, ex, ey;
+
+    // Closest wall of the sector the ray leaves through at or after t_min, or -1
+    int exitWall(const Sector& sector, float2 origin, float2 dir, float t_min, float& t_exit) const;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <Map.h>
+#include <BatchRenderer.h>
+#include <Player.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Wire format between RenderServer and RenderClient, native byte order since
+// both ends are on the same machine. Every message starts with a RenderHeader.
+//
+// The client first sends a setup message. The server answers with the frame
+// memory, a memfd passed along with the reply, holding `slots` slots of up to
+// `max_cameras` frames of width x height ARGB pixels each. Render requests then
+// name the slot to draw into, so the client can keep as many requests in flight
+// as it has slots. A slot can be reused once its reply arrived.
+const uint32_t RENDER_MAGIC = 0x51524550;   // "PERQ"
+
+enum RenderMessageType : uint32_t {
+    RENDER_SETUP    = 1,
+    RENDER_FRAMES   = 2
+};
+
+enum RenderStatus : uint32_t {
+    RENDER_OK           = 0,
+    RENDER_BAD_REQUEST  = 1,    // Unknown message, slot out of range or too many cameras
+    RENDER_NO_MEMORY    = 2     // The frame memory couldn't be created
+};
+
+struct RenderHeader {
+    uint32_t magic;
+    uint32_t type;
+};
+
+// Followed by nothing
+struct RenderSetup {
+    uint32_t slots;
+    uint32_t max_cameras;
+    uint32_t width, height;
+};
+
+// Sent back with the memfd attached
+struct RenderSetupReply {
+    uint32_t magic;
+    uint32_t status;
+    uint64_t slot_bytes;    // Slot i starts at i * slot_bytes, frame j of a slot j * width * height * 4 after that
+};
+
+// Followed by count RenderPose
+struct RenderFrames {
+    uint32_t id;            // Returned in the reply, any value
+    uint32_t slot;
+    uint32_t count;
+};
+
+struct RenderPose {
+    float x, y, z, angle;
+};
+
+struct RenderFramesReply {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t slot;
+    uint32_t status;
+    uint64_t queue_ns;      // From receiving the request to starting to render it
+    uint64_t render_ns;
+};
+
+// Serves rendered frames of one map to other processes on this machine over a
+// UNIX domain socket. Frames are written straight into memory shared with the
+// client, only small messages go through the socket. Every connection has a
+// thread reading its requests, reaped with the connection once the client goes
+// away. Requests from all connections are rendered in arrival order by one
+// render thread that spreads each batch over a BatchRenderer.
+class RenderServer {
+public:
+    // threads = 0 uses one thread per hardware thread. The map must not change while serving.
+    RenderServer(const Map& map, int threads = 0, int max_portal_depth = DEFAULT_MAX_PORTAL_DEPTH);
+    ~RenderServer();
+    // Forbid copy and assignment
+    RenderServer(const RenderServer&) = delete;
+    RenderServer operator=(const RenderServer&) = delete;
+
+    // Binds and listens on the socket path, replacing a stale socket file. Returns false on failure.
+    bool listen(const std::string& path);
+    // Accepts connections until stop() is called or stop_flag becomes non-zero
+    void run(const volatile int* stop_flag = nullptr);
+    void stop() { stopping = true; }
+
+    // Latency of every request served so far, in nanoseconds from receiving it to sending the reply
+    std::vector<uint64_t> latencies();
+    void printStats();
+
+private:
+    struct Connection;
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        RenderFrames request;
+        std::vector<RenderPose> poses;
+        uint64_t received_ns;
+    };
+
+    const Map& map;
+    BatchRenderer batch;
+    std::string socket_path;
+    int listen_fd;
+    std::atomic<bool> stopping;
+
+    std::mutex mutex;
+    std::condition_variable job_cond;
+    std::deque<Job> jobs;
+    bool finished;              // No more jobs will be queued, the render thread quits when the queue is empty
+    std::thread render_thread;
+
+    // Filled in by the render thread
+    std::mutex stats_mutex;
+    std::vector<uint64_t> latency_ns;
+    uint64_t queue_total_ns, render_total_ns;
+
+    void readRequests(std::shared_ptr<Connection> connection);
+    bool setup(Connection& connection, const RenderSetup& setup);
+    void renderJobs();
+};
+
+// Client side of the protocol, for tools and tests in C++
+class RenderClient {
+public:
+    RenderClient();
+    ~RenderClient();
+    // Forbid copy and assignment
+    RenderClient(const RenderClient&) = delete;
+    RenderClient operator=(const RenderClient&) = delete;
+
+    // Connects and maps the frame memory for slots slots of up to max_cameras width x height frames
+    bool connect(const std::string& path, int slots, int max_cameras, int width, int height);
+    // Sends a request to render cameras into the slot, doesn't wait for it
+    bool submit(uint32_t id, int slot, const Player* cameras, int count);
+    // Waits for the next reply, replies come back in the order the requests were sent
+    bool receive(RenderFramesReply& reply);
+    // Pixels of frame index of the slot, valid after the slot's reply arrived
+    const uint32_t* frame(int slot, int index) const;
+
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+
+private:
+    int fd;
+    uint8_t* memory;
+    size_t memory_bytes;
+    uint64_t slot_bytes;
+    int frame_width, frame_height;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Map.h>
+#include <CompactMap.h>
+#include <Player.h>
+#include <Framebuffer.h>
+#include <Arena.h>
+#include <PortalWalker.h>
+#include <util.h>
+#include <vector>
+#include <cstdint>
+
+// Cost counters for one frame, filled in by a renderer they are attached to
+struct RenderStats {
+    int width, height;
+    std::vector<uint16_t> pixel_writes;     // Per pixel, how often it was drawn
+    std::vector<uint16_t> column_walls;     // Per column, walls tested
+    std::vector<uint16_t> column_portals;   // Per column, portals crossed
+    unsigned long total_writes, walls_tested, portals_crossed;
+    bool detailed;      // Per pixel and per column counters too, otherwise only walls_tested and portals_crossed
+
+    RenderStats(bool detailed = true) : width(0), height(0), total_writes(0), walls_tested(0), portals_crossed(0), detailed(detailed) {}
+    // Zeroes the counters, only allocates when the size changes
+    void reset(int width, int height);
+    // Average number of writes per pixel
+    float overdraw() const { return width * height > 0 ? float(total_writes) / (width * height) : 0.0f; }
+};
+
+// Interleaved rendering, a cheaper quality mode for slow machines. Each frame
+// only every other block of columns is cast, the rest is kept from the previous
+// frame. The limits are speeds over the time since that frame, so they hold at
+// any frame rate: walking and keyboard turning (PLAYER_SPEED, 5 units or radians
+// per second) keep interleaving, faster motion or no usable previous frame casts all columns.
+struct InterleaveSettings {
+    int block;              // Columns per block, 1 alternates even and odd columns, 0 turns interleaving off
+    float max_turn_rate;    // Radians per second the camera may turn and still reuse the previous frame
+    float max_speed;        // World units per second it may move, including up and down
+};
+
+const InterleaveSettings INTERLEAVE_OFF{0, 0.0f, 0.0f};
+const float DEFAULT_INTERLEAVE_MAX_TURN_RATE = 6.0f;
+const float DEFAULT_INTERLEAVE_MAX_SPEED = 8.0f;
+
+// Column renderer for the fps view. Portals are walked with an explicit work
+// stack instead of recursion, so the cost of a column is bounded by the portal
+// depth limit and a sector is never entered twice in the same column.
+class Renderer {
+public:
+    explicit Renderer(int max_portal_depth = DEFAULT_MAX_PORTAL_DEPTH);
+
+    // Renders the view from the player's sector, draws nothing if the player is outside the map.
+    // Both map layouts give the same image when the compact one didn't have to round vertices.
+    void renderWorld(const Map& map, const Player& player, Framebuffer& frame);
+    void renderWorld(const CompactMap& map, const Player& player, Framebuffer& frame);
+
+    // Lower level interface, beginFrame has to be called before any columns are rendered
+    void beginFrame(const Map& map);
+    void beginFrame(const CompactMap& map);
+    void renderColumn(const Map& map, const Player& player, Framebuffer& frame, int sector_id, int col);
+    void renderColumn(const CompactMap& map, const Player& player, Framebuffer& frame, int sector_id, int col);
+
+    void setMaxPortalDepth(int depth);
+    int maxPortalDepth() const { return max_portal_depth; }
+    // Counts pixel writes and traversal cost into stats, nullptr turns counting off.
+    // Detailed stats always cast every column.
+    void setStats(RenderStats* stats) { this->stats = stats; }
+
+    void setInterleave(const InterleaveSettings& settings);
+    // Time of the next frame in seconds, what the interleave speeds are measured against.
+    // Without it no time passes between frames and any motion casts every column.
+    void setFrameTime(double seconds) { frame_time = seconds; }
+    // The next interleaved frame casts every column, call when the map changed
+    void invalidateHistory() { history_valid = false; }
+    // Whether the last frame cast every column
+    bool lastFrameFull() const { return last_full; }
+
+private:
+    int max_portal_depth;
+    FrameArena arena;
+    PortalStep* steps;              // Work stack, max_portal_depth + 1 entries from the arena
+    PortalWalker walker;
+    RenderStats* stats;
+
+    // Interleaving, the last frame is kept here since the caller's framebuffers may rotate
+    InterleaveSettings interleave;
+    std::vector<uint32_t> history;
+    int history_width, history_height;
+    Player history_pose;
+    double frame_time, history_time;
+    bool history_valid, last_full;
+    int parity;             // Blocks cast next frame, even or odd
+
+    // Work stack for this frame, grows the arena if it doesn't fit
+    void allocSteps();
+    void drawColumn(Framebuffer& frame, int col, int y1, int y2, RGBA clr);
+    // Both layouts share one implementation
+    template<class M> void renderView(const M& map, const Player& player, Framebuffer& frame);
+    template<class M> void renderSteps(const M& map, const Player& player, Framebuffer& frame, int sector_id, int col);
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Player.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Keys held during a frame
+enum InputKey : uint8_t {
+    KEY_FORWARD     = 1 << 0,
+    KEY_STRAFE_LEFT = 1 << 1,
+    KEY_BACK        = 1 << 2,
+    KEY_STRAFE_RIGHT= 1 << 3,
+    KEY_TURN_LEFT   = 1 << 4,
+    KEY_TURN_RIGHT  = 1 << 5,
+    KEY_DOWN        = 1 << 6,
+    KEY_UP          = 1 << 7
+};
+
+// Toggles that happened an odd number of times during a frame
+enum InputPress : uint8_t {
+    PRESS_TOGGLE_MAP    = 1 << 0,
+    PRESS_TOGGLE_MOUSE  = 1 << 1,
+    PRESS_QUIT          = 1 << 2,
+    PRESS_CYCLE_DEBUG   = 1 << 3,
+    PRESS_TOGGLE_HUD    = 1 << 4
+};
+
+// Everything the simulation reads from SDL in one frame
+struct InputFrame {
+    float dt_seconds;
+    int16_t mouse_dx;
+    int8_t wheel_y;
+    uint8_t keys;
+    uint8_t presses;
+};
+
+// File layout: "PEIR", u32 version, f32 x y z angle, then 9 bytes per frame
+// (f32 dt, i16 mouse_dx, i8 wheel_y, u8 keys, u8 presses), native byte order.
+class InputRecorder {
+public:
+    bool open(const std::string& path, const Player& start);
+    void write(const InputFrame& input);
+    bool active() const { return file.is_open(); }
+private:
+    std::ofstream file;
+};
+
+class InputReplay {
+public:
+    // Reads the header and overwrites the player with the recorded start pose
+    bool open(const std::string& path, Player& start);
+    // Returns false once the recording is exhausted
+    bool next(InputFrame& input);
+    bool active() const { return file.is_open(); }
+private:
+    std::ifstream file;
+};
@@ -24,7 +24,7 @@ struct Wall {
         return false;
     }
 
-    bool facingFront(Ray camera_ray) {
+    bool facingFront(Ray camera_ray) const {
         float2 p2p1 = p2 - p1;
         float p = (camera_ray.direction.x * p2p1.y) - (camera_ray.direction.y * p2p1.x);
         return p > 0 ? false : true;
@@ -35,8 +35,8 @@ struct Sector {
     float floor, ceil;
     int walls_begin, walls_end;
 
-    bool containsPoint(float2 point, const std::vector<Wall>& walls) {
-        Ray testRay = {point, {1, 1}}; // any ray direction works
+    bool containsPoint(float2 point, const std::vector<Wall>& walls) const {
+        Ray testRay = {point, {1, 0.618034f}}; // any ray direction that is unlikely to pass exactly through a vertex
         int numIntersections = 0;
         for (auto it = walls.begin() + walls_begin; it <= walls.begin() + walls_end; it++) {
             float2 obligatory_point; // make it so i dont have to find the point >:(
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Map.h>
+#include <Player.h>
+#include <PortalWalker.h>
+#include <linalg.h>
+#include <vector>
+#include <cstdint>
+
+using namespace linalg::aliases;
+
+struct VisibleSet {
+    std::vector<int> sectors;       // Every sector a column entered, in order of discovery
+    std::vector<int> walls;         // Every wall that was the closest hit of a column
+    std::vector<int2> wall_columns; // Only with coverage, first and last column of each wall in walls
+};
+
+// Answers what's visible from a camera by running the renderer's portal walk
+// without drawing. Uses the same FOV and column angles as a width x height
+// render, a smaller width samples fewer columns and is cheaper. The map is only
+// read, so any number of queries can run in parallel with one object per thread.
+class VisibilityQuery {
+public:
+    explicit VisibilityQuery(int max_portal_depth = DEFAULT_MAX_PORTAL_DEPTH);
+
+    // Fills result, it's cleared first and keeps its capacity between calls.
+    // A camera outside the map sees nothing.
+    void query(const Map& map, const Player& camera, int width, int height, VisibleSet& result, bool coverage = false);
+
+private:
+    int max_portal_depth;
+    std::vector<PortalStep> steps;
+    PortalWalker walker;
+    // Per sector and wall, stamp of the last query that reported it
+    std::vector<uint32_t> sector_seen, wall_seen;
+    std::vector<int> wall_index;    // Per wall, its position in result.walls for the current query
+    uint32_t query_stamp;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <util.h>
+#include <Framebuffer.h>
+#include <string>
+
+class Window {
+private:
+    SDL_Window* pWindow;
+    SDL_Renderer* pRenderer;
+    SDL_Texture* pFrame;    // Streaming texture the software framebuffer is uploaded to
+public:
+    Window(const std::string& title, int w, int h) {
+        pWindow = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, w, h, SDL_WINDOW_SHOWN);
+        pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_ACCELERATED);
+        pFrame = SDL_CreateTexture(pRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+        // Transparency
+        SDL_SetRenderDrawBlendMode(pRenderer, SDL_BLENDMODE_BLEND);
+    }
+    Window(const std::string& title, int w, int h, int px, int py) {
+        pWindow = SDL_CreateWindow(title.c_str(), px, py, w, h, SDL_WINDOW_SHOWN);
+        pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_ACCELERATED);
+        pFrame = SDL_CreateTexture(pRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+        // Transparency
+        SDL_SetRenderDrawBlendMode(pRenderer, SDL_BLENDMODE_BLEND);
+    }
+    ~Window() {
+        SDL_DestroyTexture(pFrame);
+        SDL_DestroyRenderer(pRenderer);
+        SDL_DestroyWindow(pWindow);
+    }
+    // Forbid copy and assignment
+    Window(const Window&) = delete;
+    Window operator=(const Window&) = delete;
+
+    void setTitle(const std::string& title) {
+        SDL_SetWindowTitle(pWindow, title.c_str());
+    }
+    void setTitle(const char* title) {
+        SDL_SetWindowTitle(pWindow, title);
+    }
+    void setColor(RGBA clr) {
+        SDL_SetRenderDrawColor(pRenderer, clr.r, clr.g, clr.b, clr.a);
+    }
+    void getPos(int& x, int& y) {
+        SDL_GetWindowPosition(pWindow, &x, &y);
+    }
+    void drawLine(int x1, int y1, int x2, int y2) {
+        SDL_RenderDrawLine(pRenderer, x1, y1, x2, y2);
+    }
+    void drawLineRGBA(int x1, int y1, int x2, int y2, RGBA clr) {
+        SDL_SetRenderDrawColor(pRenderer, clr.r, clr.g, clr.b, clr.a);
+        SDL_RenderDrawLine(pRenderer, x1, y1, x2, y2);
+    }
+    void drawRect(SDL_Rect rect, bool filled) {
+        if (filled) SDL_RenderFillRect(pRenderer, &rect);
+        else SDL_RenderDrawRect(pRenderer, &rect);
+    }
+    void drawRectRGBA(SDL_Rect rect, bool filled, RGBA clr) {
+        SDL_SetRenderDrawColor(pRenderer, clr.r, clr.g, clr.b, clr.a);
+        if (filled) SDL_RenderFillRect(pRenderer, &rect);
+        else SDL_RenderDrawRect(pRenderer, &rect);
+    }
+    void clear(RGBA clr) {
+        SDL_SetRenderDrawColor(pRenderer, clr.r, clr.g, clr.b, clr.a);
+        SDL_RenderClear(pRenderer);
+    }
+    // Uploads a software framebuffer of the window's size and draws it over the whole window
+    void drawFramebuffer(const Framebuffer& frame) {
+        SDL_UpdateTexture(pFrame, NULL, frame.pixels, frame.width * sizeof(uint32_t));
+        SDL_RenderCopy(pRenderer, pFrame, NULL, NULL);
+    }
+    void render() {
+        SDL_RenderPresent(pRenderer);
+    }
+    void focus() {
+        SDL_RaiseWindow(pWindow);
+    }
+};
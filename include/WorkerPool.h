@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent threads that split a loop over [0, count) into chunks. The
+// calling thread works along, so a pool of one thread starts no threads.
+class WorkerPool {
+public:
+    // threads = 0 uses one thread per hardware thread
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+    // Forbid copy and assignment
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool operator=(const WorkerPool&) = delete;
+
+    int threadCount() const { return workers.size() + 1; }
+
+    // Calls func(begin, end, thread) on chunks covering [0, count) and returns when all are done.
+    // thread is below threadCount() and no two calls with the same thread run at once.
+    template<class F> void parallelFor(int count, int chunk, F& func) {
+        run(count, chunk, [](void* context, int begin, int end, int thread) {
+            (*static_cast<F*>(context))(begin, end, thread);
+        }, &func);
+    }
+
+private:
+    using Task = void (*)(void* context, int begin, int end, int thread);
+
+    std::vector<std::thread> workers;
+
+    // Current loop
+    Task task;
+    void* context;
+    int count, chunk;
+    std::atomic<int> next;
+
+    std::mutex mutex;
+    std::condition_variable start_cond, done_cond;
+    unsigned long generation;   // Bumped for every loop
+    int loop_workers;           // Workers taking part in the current loop
+    int busy_workers;           // Of those, the ones that haven't finished yet
+    bool stopping;
+
+    void run(int count, int chunk, Task task, void* context);
+    void workerLoop(int thread);
+    void work(int thread);
+};
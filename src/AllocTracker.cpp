@@ -0,0 +1,134 @@
+#include "AllocTracker.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef TRACK_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+namespace {
+
+struct ScopeEntry {
+    std::atomic<const char*> name;
+    std::atomic<unsigned long long> allocations, bytes;
+};
+
+// Entry 0 is for allocations outside any scope, the last one for scopes that didn't fit.
+// Zero initialized before any constructor runs, so allocations during static init are counted too.
+ScopeEntry scopes[ALLOC_MAX_SCOPES];
+std::atomic<unsigned long long> total_allocations, total_bytes;
+thread_local int current_scope = 0;
+
+// Lookups only take the lock the first time a name is seen
+int scopeIndex(const char* name) {
+    static std::mutex mutex;
+    for (int i = 1; i < ALLOC_MAX_SCOPES - 1; i++) {
+        const char* entry = scopes[i].name.load(std::memory_order_acquire);
+        if (!entry) break;
+        if (entry == name || std::strcmp(entry, name) == 0) return i;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 1; i < ALLOC_MAX_SCOPES - 1; i++) {
+        const char* entry = scopes[i].name.load(std::memory_order_acquire);
+        if (!entry) {
+            scopes[i].name.store(name, std::memory_order_release);
+            return i;
+        }
+        if (entry == name || std::strcmp(entry, name) == 0) return i;
+    }
+    return ALLOC_MAX_SCOPES - 1;
+}
+
+void count(size_t size) {
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+    scopes[current_scope].allocations.fetch_add(1, std::memory_order_relaxed);
+    scopes[current_scope].bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void* allocate(size_t size) {
+    count(size);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* allocateAligned(size_t size, size_t alignment) {
+    count(size);
+    // aligned_alloc wants a multiple of the alignment
+    void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+}
+
+AllocScope::AllocScope(const char* name) : previous(current_scope) {
+    current_scope = scopeIndex(name);
+}
+
+AllocScope::~AllocScope() {
+    current_scope = previous;
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, size_t(alignment)); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+AllocCounts allocTotals() {
+    return {total_allocations.load(std::memory_order_relaxed), total_bytes.load(std::memory_order_relaxed)};
+}
+
+AllocCounts allocScopeCounts(const char* name) {
+    for (int i = 1; i < ALLOC_MAX_SCOPES; i++) {
+        const char* entry = scopes[i].name.load(std::memory_order_acquire);
+        if (entry && (entry == name || std::strcmp(entry, name) == 0))
+            return {scopes[i].allocations.load(std::memory_order_relaxed), scopes[i].bytes.load(std::memory_order_relaxed)};
+    }
+    return {0, 0};
+}
+
+void printAllocScopes() {
+    for (int i = 0; i < ALLOC_MAX_SCOPES; i++) {
+        unsigned long long allocations = scopes[i].allocations.load(std::memory_order_relaxed);
+        if (allocations == 0) continue;
+        const char* name = i == 0 ? "unscoped" : i == ALLOC_MAX_SCOPES - 1 ? "other scopes" : scopes[i].name.load();
+        std::cout << "  " << name << ": " << allocations << " allocations, " << scopes[i].bytes.load(std::memory_order_relaxed) << " bytes\n";
+    }
+}
+
+#else
+
+AllocCounts allocTotals() {
+    return {0, 0};
+}
+
+AllocCounts allocScopeCounts(const char*) {
+    return {0, 0};
+}
+
+void printAllocScopes() {
+    std::cout << "  Allocation tracking is off, build with ALLOC_TRACKING=1\n";
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+bool readMoverFile(const std::string& path, std::vector<Mover>& movers) {
+    std::ifstream mover_file(path);
+    if (!mover_file) return false;
+    std::string line;
+    std::getline(mover_file, line);
+    std::istringstream n_movers_line(line);
+    int n_movers = 0;
+    n_movers_line >> n_movers;
+    movers.clear();
+    for (int i = 0; i < n_movers; i++) {
+        std::getline(mover_file, line);
+        std::istringstream lines_stream(line);
+        std::string kind;
+        Mover mover{MOVER_DOOR, -1, {0, 0}, 1, 0};
+        lines_stream >> kind >> mover.sector;
+        if (kind == "door" || kind == "lift") {
+            mover.kind = kind == "door" ? MOVER_DOOR : MOVER_LIFT;
+            lines_stream >> mover.travel.x;
+        }
+        else if (kind == "slide") {
+            mover.kind = MOVER_SLIDE;
+            lines_stream >> mover.travel.x >> mover.travel.y;
+        }
+        else continue;
+        lines_stream >> mover.seconds >> mover.phase;
+        movers.push_back(mover);
+    }
+    return true;
+}
+
+void MapAnimator::bind(const Map& map, const std::vector<Mover>& new_movers) {
+    movers.clear();
+    for (const Mover& mover : new_movers)
+        if (mover.sector >= 0 && mover.sector < int(map.sectors.size()) && mover.seconds > 0.0f)
+            movers.push_back(mover);
+    rest_heights.assign(movers.size(), 0.0f);
+    positions.assign(movers.size(), 0.0f);
+    slide_begin.assign(1, 0);
+    slide_ends.clear();
+    dirty_begin.assign(1, 0);
+    dirty_sectors.clear();
+
+    // Wall endpoints by position, so slides can take their neighbours along
+    std::unordered_map<long long, std::vector<int>> ends_at;
+    auto key = [](float2 p) {
+        uint32_t x, y;
+        std::memcpy(&x, &p.x, 4);
+        std::memcpy(&y, &p.y, 4);
+        return (long long)x << 32 | y;
+    };
+    std::vector<int> wall_sector;
+    bool slides = std::any_of(movers.begin(), movers.end(), [](const Mover& mover) { return mover.kind == MOVER_SLIDE; });
+    if (slides) {
+        wall_sector.assign(map.walls.size(), -1);
+        for (int id = 0; id < int(map.sectors.size()); id++)
+            for (int w = map.sectors[id].walls_begin; w <= map.sectors[id].walls_end; w++)
+                wall_sector[w] = id;
+        for (int w = 0; w < int(map.walls.size()); w++) {
+            ends_at[key(map.walls[w].p1)].push_back(w * 2);
+            ends_at[key(map.walls[w].p2)].push_back(w * 2 + 1);
+        }
+    }
+
+    for (size_t i = 0; i < movers.size(); i++) {
+        const Mover& mover = movers[i];
+        const Sector& sector = map.sectors[mover.sector];
+        if (mover.kind == MOVER_DOOR) rest_heights[i] = sector.ceil;
+        if (mover.kind == MOVER_LIFT) rest_heights[i] = sector.floor;
+        if (mover.kind == MOVER_SLIDE) {
+            size_t first = slide_ends.size();
+            for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+                for (float2 p : {map.walls[w].p1, map.walls[w].p2}) {
+                    for (int end : ends_at[key(p)]) {
+                        bool second = end & 1;
+                        // Every endpoint once, even when several walls of the sector meet there
+                        auto same = [&](const SlideEnd& e) { return e.wall == end / 2 && e.second == second; };
+                        if (std::find_if(slide_ends.begin() + first, slide_ends.end(), same) != slide_ends.end()) continue;
+                        slide_ends.push_back({end / 2, second, p});
+                        int owner = wall_sector[end / 2];
+                        if (owner >= 0 && std::find(dirty_sectors.begin() + dirty_begin.back(), dirty_sectors.end(), owner) == dirty_sectors.end())
+                            dirty_sectors.push_back(owner);
+                    }
+                }
+            }
+        }
+        slide_begin.push_back(slide_ends.size());
+        dirty_begin.push_back(dirty_sectors.size());
+    }
+}
+
+int MapAnimator::apply(Map& map, double seconds) {
+    for (size_t i = 0; i < movers.size(); i++) {
+        const Mover& mover = movers[i];
+        // Triangle wave, out during the first half of the cycle and back during the second
+        float cycle = float(std::fmod(seconds / mover.seconds + mover.phase, 2.0));
+        if (cycle < 0.0f) cycle += 2.0f;
+        float position = cycle < 1.0f ? cycle : 2.0f - cycle;
+        if (position == positions[i]) continue;
+        positions[i] = position;
+
+        Sector& sector = map.sectors[mover.sector];
+        switch (mover.kind) {
+        case MOVER_DOOR :
+            sector.ceil = rest_heights[i] + mover.travel.x * position;
+            map.markDirty(mover.sector, DIRTY_HEIGHTS);
+            break;
+        case MOVER_LIFT :
+            // Floors are stored as depth below zero
+            sector.floor = rest_heights[i] - mover.travel.x * position;
+            map.markDirty(mover.sector, DIRTY_HEIGHTS);
+            break;
+        case MOVER_SLIDE :
+            for (int e = slide_begin[i]; e < slide_begin[i + 1]; e++) {
+                const SlideEnd& end = slide_ends[e];
+                (end.second ? map.walls[end.wall].p2 : map.walls[end.wall].p1) = end.rest + mover.travel * position;
+            }
+            for (int d = dirty_begin[i]; d < dirty_begin[i + 1]; d++)
+                map.markDirty(dirty_sectors[d], DIRTY_WALLS);
+            break;
+        }
+    }
+    return map.updateDirty();
+}
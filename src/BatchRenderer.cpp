@@ -0,0 +1,15 @@
+#include "BatchRenderer.h"
+
+BatchRenderer::BatchRenderer(int threads, int max_portal_depth) :
+    pool(threads),
+    renderers(pool.threadCount(), Renderer(max_portal_depth))
+{
+}
+
+void BatchRenderer::render(const Map& map, const Player* cameras, Framebuffer* frames, int count) {
+    auto render_cameras = [&](int begin, int end, int thread) {
+        for (int i = begin; i < end; i++)
+            renderers[thread].renderWorld(map, cameras[i], frames[i]);
+    };
+    pool.parallelFor(count, CHUNK, render_cameras);
+}
@@ -0,0 +1,202 @@
+#include "CompactMap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+CompactMap::CompactMap() :
+    origin(0.0f, 0.0f), step(1.0f),
+    grid_min(0, 0), grid_size(0, 0),
+    max_error(0.0f)
+{
+}
+
+bool CompactMap::build(const Map& map, int precision_bits) {
+    for (const Sector& sector : map.sectors)
+        if (sector.walls_end - sector.walls_begin + 1 > 0xffff) return false;
+
+    // Finer steps would overflow 32 bit vertices on large maps
+    step = std::ldexp(1.0f, -std::min(std::max(precision_bits, 0), 16));
+    float2 map_min{INFINITY, INFINITY}, map_max{-INFINITY, -INFINITY};
+    for (const SectorBounds& b : map.bounds) {
+        if (b.min.x > b.max.x) continue; // sector without walls
+        map_min = linalg::min(map_min, b.min);
+        map_max = linalg::max(map_max, b.max);
+    }
+    if (map_min.x > map_max.x) map_min = map_max = {0.0f, 0.0f};
+    // A corner on the grid keeps vertices that are multiples of step exact
+    origin = linalg::floor(map_min / step) * step;
+
+    // Vertex pool, walls whose endpoints are exactly the same point share the vertex.
+    // Points that only round to the same place keep vertices of their own, a mover
+    // may slide one of them and not the other.
+    std::vector<int2> pool;
+    std::unordered_map<unsigned long long, uint32_t> pool_ids;
+    max_error = 0.0f;
+    auto vertexId = [&](float2 p) {
+        int2 q = quantize(p);
+        max_error = std::max(max_error, linalg::length(origin + float2(q) * step - p));
+        uint32_t x, y;
+        std::memcpy(&x, &p.x, sizeof(x));
+        std::memcpy(&y, &p.y, sizeof(y));
+        auto found = pool_ids.emplace((unsigned long long)x << 32 | y, uint32_t(pool.size()));
+        if (found.second) pool.push_back(q);
+        return found.first->second;
+    };
+    wall_vertices.resize(map.walls.size());
+    for (size_t i = 0; i < map.walls.size(); i++) {
+        wall_vertices[i].v1 = vertexId(map.walls[i].p1);
+        wall_vertices[i].v2 = vertexId(map.walls[i].p2);
+    }
+
+    // Walls outside every sector can lie below the corner
+    int2 lowest(0, 0), extent(0, 0);
+    for (int2 q : pool) {
+        lowest = linalg::min(lowest, q);
+        extent = linalg::max(extent, q);
+    }
+    vertices16.clear();
+    vertices32.clear();
+    if (lowest.x >= 0 && lowest.y >= 0 && extent.x <= 0xffff && extent.y <= 0xffff) {
+        vertices16.reserve(pool.size());
+        for (int2 q : pool)
+            vertices16.push_back({uint16_t(q.x), uint16_t(q.y)});
+    }
+    else {
+        vertices32.swap(pool);
+    }
+    vertices16.shrink_to_fit();
+    vertices32.shrink_to_fit();
+
+    portals16.clear();
+    portals32.clear();
+    if (map.sectors.size() < NO_SECTOR16) {
+        portals16.reserve(map.walls.size());
+        for (const Wall& wall : map.walls)
+            portals16.push_back(wall.next_sector < 0 ? NO_SECTOR16 : uint16_t(wall.next_sector));
+    }
+    else {
+        portals32.reserve(map.walls.size());
+        for (const Wall& wall : map.walls)
+            portals32.push_back(wall.next_sector);
+    }
+
+    sectors.resize(map.sectors.size());
+    heights.resize(map.sectors.size());
+    for (size_t i = 0; i < map.sectors.size(); i++) {
+        const Sector& sector = map.sectors[i];
+        sectors[i] = {uint32_t(sector.walls_begin), uint16_t(sector.walls_end - sector.walls_begin + 1)};
+        heights[i] = {sector.floor, sector.ceil};
+    }
+    bounds = map.bounds;
+    moved.clear();
+    moved_slots.clear();
+    lighting = map.lighting;
+    buildIndex();
+    return true;
+}
+
+int2 CompactMap::quantize(float2 p) const {
+    // step is a power of two, dividing by it is exact
+    float2 v = (p - origin) / step + float2(0.5f, 0.5f);
+    // Truncate and fix up negatives, std::floor is a library call here
+    int2 q(int(v.x), int(v.y));
+    return {q.x - (v.x < q.x), q.y - (v.y < q.y)};
+}
+
+void CompactMap::updateSectors(const Map& map, const std::vector<int>& ids) {
+    int2 limit = narrowVertices() ? int2(0xffff, 0xffff) : int2(INT32_MAX, INT32_MAX);
+    auto requantize = [&](uint32_t id, float2 p) {
+        int2 q = linalg::clamp(quantize(p), int2(0, 0), limit);
+        if (narrowVertices()) vertices16[id] = {uint16_t(q.x), uint16_t(q.y)};
+        else vertices32[id] = q;
+    };
+    for (int id : ids) {
+        const Sector& sector = map.sectors[id];
+        heights[id] = {sector.floor, sector.ceil};
+        if (!(map.updatedFlags(id) & DIRTY_WALLS)) continue;
+        // A vertex is only shared by endpoints that were the same point, and a slide moves
+        // all of those and marks their sectors dirty, so writing it in place is safe
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+            requantize(wall_vertices[w].v1, map.walls[w].p1);
+            requantize(wall_vertices[w].v2, map.walls[w].p2);
+        }
+        // The index keeps the position the sector was built at, sectors whose walls
+        // moved are looked up in a short list of their own instead
+        if (map.bounds[id].min == bounds[id].min && map.bounds[id].max == bounds[id].max) continue;
+        if (moved_slots.empty()) moved_slots.assign(sectors.size(), -1);
+        if (moved_slots[id] < 0) {
+            moved_slots[id] = moved.size();
+            moved.push_back({id, map.bounds[id]});
+        }
+        moved[moved_slots[id]].bounds = map.bounds[id];
+    }
+}
+
+void CompactMap::buildIndex() {
+    grid_min = int2(linalg::floor(origin / MAP_CELL_SIZE));
+    int2 grid_max = grid_min;
+    for (const SectorBounds& b : bounds)
+        if (b.min.x <= b.max.x) grid_max = linalg::max(grid_max, int2(linalg::floor(b.max / MAP_CELL_SIZE)));
+    grid_size = grid_max - grid_min + int2(1, 1);
+
+    // Count, prefix sum, then fill, so the index is two flat arrays
+    cell_start.assign(size_t(grid_size.x) * grid_size.y + 1, 0);
+    auto forCells = [&](const SectorBounds& b, auto f) {
+        if (b.min.x > b.max.x) return;
+        int2 lo = int2(linalg::floor(b.min / MAP_CELL_SIZE)) - grid_min;
+        int2 hi = int2(linalg::floor(b.max / MAP_CELL_SIZE)) - grid_min;
+        for (int cy = lo.y; cy <= hi.y; cy++)
+            for (int cx = lo.x; cx <= hi.x; cx++)
+                f(size_t(cy) * grid_size.x + cx);
+    };
+    for (const SectorBounds& b : bounds)
+        forCells(b, [&](size_t cell) { cell_start[cell + 1]++; });
+    for (size_t i = 1; i < cell_start.size(); i++)
+        cell_start[i] += cell_start[i - 1];
+    cell_sectors.resize(cell_start.back());
+    std::vector<uint32_t> fill(cell_start.begin(), cell_start.end() - 1);
+    for (size_t id = 0; id < bounds.size(); id++)
+        forCells(bounds[id], [&](size_t cell) { cell_sectors[fill[cell]++] = id; });
+}
+
+bool CompactMap::containsPoint(int sector, float2 point) const {
+    // Same test as Sector::containsPoint
+    Ray testRay = {point, {1, 0.618034f}};
+    int numIntersections = 0;
+    for (int w = wallsBegin(sector); w <= wallsEnd(sector); w++) {
+        float2 obligatory_point;
+        if (wall(w).rayIntersect(testRay, &obligatory_point))
+            numIntersections++;
+    }
+    return numIntersections % 2 > 0;
+}
+
+int CompactMap::locateSector(float2 point) const {
+    int cx = int(std::floor(point.x / MAP_CELL_SIZE)) - grid_min.x;
+    int cy = int(std::floor(point.y / MAP_CELL_SIZE)) - grid_min.y;
+    if (cx >= 0 && cy >= 0 && cx < grid_size.x && cy < grid_size.y) {
+        size_t cell = size_t(cy) * grid_size.x + cx;
+        for (uint32_t i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+            int id = cell_sectors[i];
+            if (!moved_slots.empty() && moved_slots[id] >= 0) continue;
+            if (bounds[id].containsPoint(point) && containsPoint(id, point))
+                return id;
+        }
+    }
+    for (const MovedSector& sector : moved)
+        if (sector.bounds.containsPoint(point) && containsPoint(sector.id, point))
+            return sector.id;
+    return -1;
+}
+
+size_t CompactMap::memoryBytes() const {
+    return sectors.capacity() * sizeof(SectorRange) + wall_vertices.capacity() * sizeof(WallVertices)
+         + vertices16.capacity() * sizeof(Vertex16) + vertices32.capacity() * sizeof(int2)
+         + portals16.capacity() * sizeof(uint16_t) + portals32.capacity() * sizeof(int32_t)
+         + heights.capacity() * sizeof(float2) + bounds.capacity() * sizeof(SectorBounds)
+         + cell_start.capacity() * sizeof(uint32_t) + cell_sectors.capacity() * sizeof(uint32_t)
+         + moved.capacity() * sizeof(MovedSector) + moved_slots.capacity() * sizeof(int)
+         + (lighting.walls.capacity() + lighting.floors.capacity() + lighting.ceils.capacity()) * sizeof(float);
+}
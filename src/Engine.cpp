@@ -1,201 +1,420 @@
 #include "Engine.h"
 
-Engine::Engine(unsigned int width, unsigned int height) :
+Engine::Engine(unsigned int width, unsigned int height, const std::string& map_path, bool headless) :
     running(true),
     window_width(width), window_height(height),
-    main_window(Window("Engine", width, height)),
+    main_window(headless ? nullptr : new Window("Engine", width, height)),
+    hud_stats(false),
+    debug_title(false), debug_title_text(), debug_title_time(0),
     time_init(SDL_GetPerformanceCounter()),
     time_prev(0), time_curr(time_init), dt_seconds(0.0), time_total_seconds(0.0),
     player({{1,1,0}, 0}),
     current_state(MAP),
-    map_zoom(32)
+    map_zoom(32),
+    presented_frames(0), latency_total_seconds(0.0), latency_max_seconds(0.0),
+    hud_visible(false), events_start(0), last_present(0), event_ms(0.0f), present_ms(0.0f),
+    frames_started(0), allocating_frames(0), frame_allocs{0, 0}, steady_allocs{0, 0},
+    map_path(map_path),
+    map_watcher(map_path),
+    compact_precision(-1),
+    animation_time(0.0),
+    input(),
+    replay_fixed_dt(0.0), replay_frames(0), replay_render_seconds(0.0), replay_hash(14695981039346656037ull)
 {
-    // Read map - needs to be a bit more concise lmao
-    std::ifstream map_file("map");
-    std::string line;
-    std::getline(map_file, line);
-    std::istringstream n_walls_line(line);
-    int n_walls;
-    n_walls_line >> n_walls;
-    for (int i = 0; i < n_walls; i++) {
-        std::getline(map_file, line);
-        std::cout << line << std::endl;
-        std::istringstream lines_stream(line);
-        float2 p1, p2;
-        int sec_id;
-        lines_stream >> p1.x >> p1.y >> p2.x >> p2.y >> sec_id;
-        walls.push_back({p1, p2, sec_id});
-    }
-    std::getline(map_file, line);
-    std::istringstream n_secs_line(line);
-    int n_secs;
-    n_secs_line >> n_secs;
-    for (int i = 0; i < n_secs; i++) {
-        std::getline(map_file, line);
-        std::cout << line << std::endl;
-        std::istringstream lines_stream(line);
-        float floor, ceil;
-        int w_begin, w_end;
-        lines_stream >> floor >> ceil >> w_begin >> w_end;
-        sectors.push_back({floor, ceil, w_begin, w_end});
-    }
+    if (map.load(map_path))
+        std::cout << "Loaded " << map_path << ": " << map.walls.size() << " walls, " << map.sectors.size() << " sectors" << std::endl;
+    else
+        std::cout << "Could not load " << map_path << " (run mapc on it for details)" << std::endl;
+    setFramesInFlight(1);
 }
 
 Engine::~Engine() {
+    if (replayer.active()) {
+        pipeline->flush([&](int slot, Framebuffer& frame, double render_seconds) { presentFrame(slot, frame, render_seconds); });
+        finishReplay();
+    }
+    pipeline.reset();
+    if (frame_capture.active()) {
+        frame_capture.close();
+        frame_capture.printStats();
+    }
+    if (presented_frames > 0)
+        std::cout << "Presented " << presented_frames << " frames, input to present latency mean "
+                  << 1000.0 * latency_total_seconds / presented_frames << " ms, max " << 1000.0 * latency_max_seconds << " ms" << std::endl;
+    if (ALLOC_TRACKING && frames_started > ALLOC_WARMUP_FRAMES) {
+        std::cout << allocating_frames << " of " << frames_started - ALLOC_WARMUP_FRAMES << " frames after the first "
+                  << ALLOC_WARMUP_FRAMES << " allocated, " << steady_allocs.allocations << " allocations, "
+                  << steady_allocs.bytes << " bytes. All frames by scope:" << std::endl;
+        printAllocScopes();
+    }
+    main_window.reset();
     SDL_Quit();
 }
 
+void Engine::setFramesInFlight(int frames) {
+    pipeline.reset(new FramePipeline(window_width, window_height, frames,
+        [this](int slot, Framebuffer& frame) { renderFrame(slot, frame); }));
+    frame_states.resize(pipeline->slotCount());
+}
+
+void Engine::setInterleave(int block) {
+    pipeline->wait();
+    renderer.setInterleave({block, DEFAULT_INTERLEAVE_MAX_TURN_RATE, DEFAULT_INTERLEAVE_MAX_SPEED});
+}
+
+bool Engine::record(const std::string& path) {
+    return recorder.open(path, player);
+}
+
+bool Engine::replay(const std::string& path, const std::string& timing_path, double fixed_dt) {
+    if (!replayer.open(path, player)) return false;
+    timing_log.open(timing_path);
+    timing_log << "frame,render_ms,hash,overdraw,walls_tested,portals_crossed\n";
+    replay_fixed_dt = fixed_dt;
+    // Replays always start from the same state
+    current_state = MAP;
+    map_zoom = 32;
+    return true;
+}
+
+void Engine::finishReplay() {
+    std::cout << "Replayed " << replay_frames << " frames, mean render "
+              << (replay_frames ? 1000.0 * replay_render_seconds / replay_frames : 0.0) << " ms, hash "
+              << std::hex << replay_hash << std::dec << std::endl;
+}
+
 void Engine::startFrame() {
+    // Allocations of the previous frame, wherever they happened
+    AllocCounts allocs = allocTotals();
+    if (frames_started++ > ALLOC_WARMUP_FRAMES && allocs.allocations != frame_allocs.allocations) {
+        allocating_frames++;
+        steady_allocs.allocations += allocs.allocations - frame_allocs.allocations;
+        steady_allocs.bytes += allocs.bytes - frame_allocs.bytes;
+    }
+    frame_allocs = allocs;
     time_prev = time_curr;
     time_curr = SDL_GetPerformanceCounter();
     dt_seconds = (double) (time_curr - time_prev) / (double) SDL_GetPerformanceFrequency();
+    if (replayer.active()) {
+        if (!replayer.next(input)) {
+            running = false;
+            return;
+        }
+        dt_seconds = replay_fixed_dt > 0.0 ? replay_fixed_dt : input.dt_seconds;
+    }
+    else {
+        // Recordings store the step as a float, live runs take the same rounded step
+        // so that replaying them steps the simulation identically
+        dt_seconds = float(dt_seconds);
+    }
     time_total_seconds += dt_seconds;
 }
 
 void Engine::events() {
+    AllocScope scope("events");
+    events_start = SDL_GetPerformanceCounter();
+    if (!replayer.active()) {
+        input = pollInput();
+        if (recorder.active()) recorder.write(input);
+    }
+    applyInput();
+}
+
+InputFrame Engine::pollInput() {
+    InputFrame polled{float(dt_seconds), 0, 0, 0, 0};
+    int wheel_y = 0;
     SDL_Event event;
     while(SDL_PollEvent(&event)) {
         switch(event.type) {
         case SDL_QUIT :
-            running = false;
+            polled.presses |= PRESS_QUIT;
             break;
         case SDL_KEYDOWN :
             switch(event.key.keysym.sym) {
             case SDLK_TAB : // if in render go to map, if not go back to render
-                current_state = current_state == WORLD ? MAP : WORLD;
+                polled.presses ^= PRESS_TOGGLE_MAP;
                 break;
             case SDLK_ESCAPE :
-                SDL_SetRelativeMouseMode(SDL_bool(!SDL_GetRelativeMouseMode()));
+                polled.presses ^= PRESS_TOGGLE_MOUSE;
+                break;
+            case SDLK_F1 : // cycle through the debug views
+                polled.presses ^= PRESS_CYCLE_DEBUG;
+                break;
+            case SDLK_F2 : // performance overlay
+                polled.presses ^= PRESS_TOGGLE_HUD;
                 break;
             }
             break;
         case SDL_MOUSEWHEEL :
-            map_zoom += event.wheel.y;
-            if (map_zoom < 0) map_zoom = 0;
+            wheel_y += event.wheel.y;
             break;
         case SDL_WINDOWEVENT :
             switch(event.window.type) {
             case SDL_WINDOWEVENT_CLOSE :
-                running = false;
+                polled.presses |= PRESS_QUIT;
                 break;
             }
             break;
         }
     }
+    polled.wheel_y = std::max(-128, std::min(wheel_y, 127));
+
     // Relative mouse movement
     int mouse_dx;
     SDL_GetRelativeMouseState(&mouse_dx, NULL);
-    player.angle += MOUSE_SENSITIVITY * mouse_dx;
+    polled.mouse_dx = std::max(-32768, std::min(mouse_dx, 32767));
 
     // Access keys with keystate[SDL_SCANCODE(key)]
     const Uint8* keystate = SDL_GetKeyboardState(NULL);
-    if(keystate[SDL_SCANCODE_W])
+    if(keystate[SDL_SCANCODE_W])        polled.keys |= KEY_FORWARD;
+    if(keystate[SDL_SCANCODE_A])        polled.keys |= KEY_STRAFE_LEFT;
+    if(keystate[SDL_SCANCODE_S])        polled.keys |= KEY_BACK;
+    if(keystate[SDL_SCANCODE_D])        polled.keys |= KEY_STRAFE_RIGHT;
+    if(keystate[SDL_SCANCODE_LEFT])     polled.keys |= KEY_TURN_LEFT;
+    if(keystate[SDL_SCANCODE_RIGHT])    polled.keys |= KEY_TURN_RIGHT;
+    if(keystate[SDL_SCANCODE_LSHIFT])   polled.keys |= KEY_DOWN;
+    if(keystate[SDL_SCANCODE_SPACE])    polled.keys |= KEY_UP;
+    return polled;
+}
+
+void Engine::applyInput() {
+    if (input.presses & PRESS_QUIT)
+        running = false;
+    if (input.presses & PRESS_TOGGLE_MAP)
+        current_state = current_state == WORLD ? MAP : WORLD;
+    if (input.presses & PRESS_TOGGLE_HUD)
+        hud_visible = !hud_visible;
+    if (input.presses & PRESS_CYCLE_DEBUG)
+        current_state = current_state == OVERDRAW ? COST : current_state == COST ? WORLD : OVERDRAW;
+    if ((input.presses & PRESS_TOGGLE_MOUSE) && main_window)
+        SDL_SetRelativeMouseMode(SDL_bool(!SDL_GetRelativeMouseMode()));
+    map_zoom += input.wheel_y;
+    if (map_zoom < 0) map_zoom = 0;
+
+    player.angle += MOUSE_SENSITIVITY * input.mouse_dx;
+
+    if(input.keys & KEY_FORWARD)
         player.pos += PLAYER_SPEED * float(dt_seconds) * float3{cos(player.angle), sin(player.angle), 0};
-    if(keystate[SDL_SCANCODE_A])
+    if(input.keys & KEY_STRAFE_LEFT)
         player.pos += PLAYER_SPEED * float(dt_seconds) * float3{cos(player.angle-3.1415f/2), sin(player.angle-3.1415f/2), 0};
-    if(keystate[SDL_SCANCODE_S])
+    if(input.keys & KEY_BACK)
         player.pos -= PLAYER_SPEED * float(dt_seconds) * float3{cos(player.angle), sin(player.angle), 0};
-    if(keystate[SDL_SCANCODE_D])
+    if(input.keys & KEY_STRAFE_RIGHT)
         player.pos -= PLAYER_SPEED * float(dt_seconds) * float3{cos(player.angle-3.1415f/2), sin(player.angle-3.1415f/2), 0};
-    if(keystate[SDL_SCANCODE_LEFT])
+    if(input.keys & KEY_TURN_LEFT)
         player.angle -= dt_seconds * PLAYER_SPEED;
-    if(keystate[SDL_SCANCODE_RIGHT])
+    if(input.keys & KEY_TURN_RIGHT)
         player.angle += dt_seconds * PLAYER_SPEED;
-    if(keystate[SDL_SCANCODE_LSHIFT])
+    if(input.keys & KEY_DOWN)
         player.pos.z -= dt_seconds * PLAYER_SPEED;
-    if(keystate[SDL_SCANCODE_SPACE])
+    if(input.keys & KEY_UP)
         player.pos.z += dt_seconds * PLAYER_SPEED;
 
 }
 
 void Engine::update() {
+    AllocScope scope("update");
+    // Live map reload, the player keeps its pose. Replays keep the map they started with.
+    if (!replayer.active() && map_watcher.changed()) {
+        // The render stage reads the map
+        pipeline->wait();
+        Uint64 reload_start = SDL_GetPerformanceCounter();
+        int rebuilt = map.reload(map_path);
+        double reload_ms = 1000.0 * (SDL_GetPerformanceCounter() - reload_start) / SDL_GetPerformanceFrequency();
+        if (rebuilt >= 0)
+            std::cout << "Reloaded " << map_path << ": " << rebuilt << " sectors rebuilt in " << reload_ms << " ms" << std::endl;
+        else
+            std::cout << "Could not reload " << map_path << ", kept the old map (run mapc on it for details)" << std::endl;
+        if (rebuilt >= 0 && compact_precision >= 0) buildCompactMap();
+        if (rebuilt >= 0) renderer.invalidateHistory();
+        // The reloaded sectors are the new rest positions
+        if (rebuilt >= 0) animator.bind(map, movers);
+    }
+    animation_time += dt_seconds;
+    event_ms = 1000.0f * (SDL_GetPerformanceCounter() - events_start) / SDL_GetPerformanceFrequency();
+}
+
+bool Engine::loadMovers(const std::string& path) {
+    if (!readMoverFile(path, movers)) return false;
+    pipeline->wait();
+    animator.bind(map, movers);
+    std::cout << "Loaded " << animator.moverCount() << " movers from " << path << std::endl;
+    return true;
+}
+
+bool Engine::capture(const std::string& path, CaptureFormat format, int fps) {
+    return frame_capture.open(path, window_width, window_height, format, fps);
+}
+
+void Engine::useCompactMap(int precision_bits) {
+    pipeline->wait();
+    compact_precision = precision_bits;
+    buildCompactMap();
+}
 
+void Engine::buildCompactMap() {
+    if (!compact_map.build(map, compact_precision)) {
+        std::cout << "Map has a sector with too many walls for the compact layout" << std::endl;
+        compact_precision = -1;
+        return;
+    }
+    std::cout << "Map memory: " << map.memoryBytes() << " bytes, compact " << compact_map.memoryBytes() << " bytes ("
+              << compact_map.vertexCount() << " shared vertices for " << map.walls.size() << " walls, "
+              << (compact_map.narrowVertices() ? "16" : "32") << " bit vertices, "
+              << (compact_map.narrowPortals() ? "16" : "32") << " bit portals, max rounding error "
+              << compact_map.maxError() << ")" << std::endl;
 }
 
 void Engine::render() {
-    switch (current_state) {
+    frame_states[pipeline->nextSlot()] = FrameState{player, current_state, map_zoom, time_curr, animation_time, hud_visible, event_ms, 0.0f, 0, 0, false};
+    pipeline->submit();
+    pipeline->present([&](int slot, Framebuffer& frame, double render_seconds) { presentFrame(slot, frame, render_seconds); });
+}
+
+// Render stage, runs on the pipeline's thread
+void Engine::renderFrame(int slot, Framebuffer& frame) {
+    AllocScope scope("render");
+    FrameState& state = frame_states[slot];
+    // Only the sectors that moved are updated, in the map and in the compact copy.
+    // Columns kept from the last frame would show them where they were.
+    if (animator.moverCount() > 0 && animator.apply(map, state.animation_time) > 0) {
+        if (compact_precision >= 0) compact_map.updateSectors(map, map.updatedSectors());
+        renderer.invalidateHistory();
+    }
+    // Simulation time, so interleaving decides the same way in a replay
+    renderer.setFrameTime(state.animation_time);
+    switch (state.state) {
     case WORLD :
-        renderWorld();
+        if (state.hud) renderer.setStats(&hud_stats);
+        renderWorld(state.player, frame);
+        if (state.hud) {
+            renderer.setStats(nullptr);
+            state.walls_tested = hud_stats.walls_tested;
+            state.portals_crossed = hud_stats.portals_crossed;
+            state.partial = !renderer.lastFrameFull();
+        }
         break;
     case MAP :
-        renderMap();
+        // The kept frame goes stale while the map is up
+        renderer.invalidateHistory();
+        renderMap(state, frame);
+        break;
+    case OVERDRAW :
+    case COST :
+        renderCost(state, frame);
         break;
     };
-    main_window.render();
 }
 
-void Engine::renderMap() {
-    main_window.clear(RGBA{255,255,255,255});
-    main_window.setColor(RGBA{0,0,0,255});
-    for (Sector sector : sectors) { // kind of a odd way to iterate through walls lmao
-        for (auto it = walls.begin() + sector.walls_begin; it <= walls.begin() + sector.walls_end; it++) {
-            main_window.drawLine(worldToMap(it->p1).x , worldToMap(it->p1).y, worldToMap(it->p2).x, worldToMap(it->p2).y);
-        }
+// Present stage, runs on the main thread
+void Engine::presentFrame(int slot, Framebuffer& frame, double render_seconds) {
+    AllocScope scope("present");
+    if (replayer.active()) {
+        uint64_t frame_hash = frame.hash();
+        const FrameState& state = frame_states[slot];
+        timing_log << replay_frames << ',' << 1000.0 * render_seconds << ',' << std::hex << frame_hash << std::dec << ','
+                   << state.overdraw << ',' << state.walls_tested << ',' << state.portals_crossed << '\n';
+        replay_hash = (replay_hash ^ frame_hash) * 1099511628211ull;
+        replay_render_seconds += render_seconds;
+        replay_frames++;
     }
-    int2 player_map_direction{int(cos(player.angle) * map_zoom + window_width / 2 ), int(sin(player.angle) * map_zoom + window_height / 2)};
-    main_window.drawLine(window_width/2, window_height/2, player_map_direction.x, player_map_direction.y);
-}
-
-void Engine::renderWorld() {
-    for (int column = 0; column < window_width; column++) {
-        float radians = player.angle + atan(window_width/window_height * FOV * float(column-window_width/2) / float(window_width/2));
-        Ray camera_ray({player.pos.xy(), {cos(radians), sin(radians)} });
-        for (Sector sector : sectors) { // naiive, breaks
-            if (sector.containsPoint(player.pos.xy(), walls)) {
-                renderSector(sector, column, camera_ray, radians);
+    // Drawn after hashing so replays give the same hashes with the overlay on
+    Uint64 present_start = SDL_GetPerformanceCounter();
+    const FrameState& state = frame_states[slot];
+    if (state.hud) {
+        double frequency = SDL_GetPerformanceFrequency();
+        hud.record(FrameTimes{last_present ? float(1000.0 * (present_start - last_present) / frequency) : 0.0f,
+                              float(1000.0 * render_seconds), state.event_ms, present_ms, state.walls_tested, state.portals_crossed, state.partial});
+        hud.draw(frame);
+    }
+    if (main_window) {
+        if (state.state == OVERDRAW || state.state == COST) {
+            // Formatted without allocating and set only when it changed, a few times a second at most
+            if (!debug_title || present_start - debug_title_time >= SDL_GetPerformanceFrequency() / DEBUG_TITLE_UPDATES_PER_SECOND) {
+                char title[sizeof(debug_title_text)];
+                std::snprintf(title, sizeof(title), "Engine - overdraw %gx, %lu walls tested, %lu portals crossed",
+                              state.overdraw, state.walls_tested, state.portals_crossed);
+                if (!debug_title || std::strcmp(title, debug_title_text) != 0) {
+                    std::memcpy(debug_title_text, title, sizeof(title));
+                    main_window->setTitle(debug_title_text);
+                }
+                debug_title_time = present_start;
+                debug_title = true;
             }
         }
+        else if (debug_title) {
+            main_window->setTitle("Engine");
+            debug_title = false;
+        }
+        main_window->drawFramebuffer(frame);
+        main_window->render();
     }
+    last_present = present_start;
+    present_ms = 1000.0f * (SDL_GetPerformanceCounter() - present_start) / SDL_GetPerformanceFrequency();
+    // Takes the pixels, so this goes last
+    if (frame_capture.active()) frame_capture.push(frame);
+    double latency = (double) (SDL_GetPerformanceCounter() - frame_states[slot].input_time) / (double) SDL_GetPerformanceFrequency();
+    latency_total_seconds += latency;
+    latency_max_seconds = std::max(latency_max_seconds, latency);
+    presented_frames++;
 }
 
-void Engine::renderSector(const Sector& sector, int col, Ray camera_ray, float radians) {
-    // Find nearest intersection in sectors walls
-    float dist_closest = INFINITY;
-    int closest_wall_id = -1;
-    for (auto it = walls.begin() + sector.walls_begin; it <= walls.begin() + sector.walls_end; it++) {
-        float2 intersection_point;
-        if ((*it).facingFront(camera_ray) && (*it).rayIntersect(camera_ray, &intersection_point)) {
-            float dist_euc = sqrt((player.pos.x-intersection_point.x)*(player.pos.x-intersection_point.x) + (player.pos.y-intersection_point.y)*(player.pos.y-intersection_point.y));
-            float dist_flat = dist_euc * cos(radians - player.angle);
-            if (dist_flat < dist_closest) {
-                dist_closest = dist_flat;
-                closest_wall_id = it - walls.begin();
-            }
+void Engine::renderWorld(const Player& player, Framebuffer& frame) {
+    if (compact_precision >= 0) renderer.renderWorld(compact_map, player, frame);
+    else renderer.renderWorld(map, player, frame);
+}
+
+void Engine::renderMap(const FrameState& state, Framebuffer& frame) {
+    frame.clear(RGBA{255,255,255,255});
+    for (const Sector& sector : map.sectors) { // kind of a odd way to iterate through walls lmao
+        for (auto it = map.walls.begin() + sector.walls_begin; it <= map.walls.begin() + sector.walls_end; it++) {
+            frame.drawLine(worldToMap(state, it->p1).x , worldToMap(state, it->p1).y, worldToMap(state, it->p2).x, worldToMap(state, it->p2).y, RGBA{0,0,0,255});
         }
     }
+    int2 player_map_direction{int(cos(state.player.angle) * state.map_zoom + window_width / 2 ), int(sin(state.player.angle) * state.map_zoom + window_height / 2)};
+    frame.drawLine(window_width/2, window_height/2, player_map_direction.x, player_map_direction.y, RGBA{0,0,0,255});
+}
 
-    // Find top and bottom of the wall or portal
-    int wall_top = window_height/2 - (window_height/dist_closest * (sector.ceil  - player.pos.z)) / (FOV);
-    int wall_bot = window_height/2 + (window_height/dist_closest * (sector.floor + player.pos.z)) / (FOV);
+// Black through blue, cyan, green and yellow to red as t goes from 0 to 1
+static RGBA heatColor(float t) {
+    static const RGBA stops[] = {{0,0,0,255}, {0,0,255,255}, {0,255,255,255}, {0,255,0,255}, {255,255,0,255}, {255,0,0,255}};
+    float x = std::max(0.0f, std::min(t, 1.0f)) * 5;
+    int i = std::min(int(x), 4);
+    float f = x - i;
+    return RGBA{(unsigned char) (stops[i].r + f * (stops[i+1].r - stops[i].r)),
+                (unsigned char) (stops[i].g + f * (stops[i+1].g - stops[i].g)),
+                (unsigned char) (stops[i].b + f * (stops[i+1].b - stops[i].b)), 255};
+}
 
-    // if the wall exists
-    if (closest_wall_id >= 0) {
-        // if the wall does not continue to another sector
-        if (walls[closest_wall_id].next_sector == -1) {
-            main_window.drawLineRGBA(col, wall_top, col, wall_bot, RGBA {0, 0, (unsigned char) (255/std::max(dist_closest+1.0f, 1.0f)), 255} );
-        }
-        // if the wall does go to another sector
-        else {
-            // Render next sector through portal
-            if (walls[closest_wall_id].next_sector >= 0) {
-                renderSector(sectors[walls[closest_wall_id].next_sector], col, camera_ray, radians);
-
-                // Render top and bottom
-                int topTop = window_height/2 - (window_height/dist_closest * (sector.ceil - player.pos.z)) / (FOV);
-                int botTop = window_height/2 - (window_height/dist_closest * (sectors[walls[closest_wall_id].next_sector].ceil - player.pos.z)) / (FOV);
-                main_window.drawLineRGBA(col, topTop, col, botTop, RGBA {255, 0, 255, 255} );
-
-                int botBot = window_height/2 + (window_height/dist_closest * (sectors[walls[closest_wall_id].next_sector].floor + player.pos.z)) / (FOV);
-                int topBot = window_height/2 + (window_height/dist_closest * (sector.floor + player.pos.z)) / (FOV);
-                main_window.drawLineRGBA(col, topBot, col, botBot, RGBA {255, 255, 0 , 255} );
-            }
-        }
+void Engine::renderCost(FrameState& state, Framebuffer& frame) {
+    renderer.setStats(&render_stats);
+    // The layout the world view draws from, so the numbers describe what's on screen
+    renderWorld(state.player, frame);
+    renderer.setStats(nullptr);
+    state.overdraw = render_stats.overdraw();
+    state.walls_tested = render_stats.walls_tested;
+    state.portals_crossed = render_stats.portals_crossed;
+
+    if (state.state == OVERDRAW) {
+        // Fixed scale so frames can be compared, red is 8 or more writes
+        for (size_t i = 0; i < frame.size(); i++)
+            frame.pixels[i] = Framebuffer::pack(heatColor(render_stats.pixel_writes[i] / 8.0f));
+        return;
+    }
+
+    // Scaled to the most expensive column of the frame
+    int max_walls = 1, max_portals = 1;
+    for (int col = 0; col < frame.width; col++) {
+        max_walls = std::max(max_walls, int(render_stats.column_walls[col]));
+        max_portals = std::max(max_portals, int(render_stats.column_portals[col]));
+    }
+    for (int col = 0; col < frame.width; col++) {
+        frame.drawColumn(col, 0, frame.height - 1, heatColor(float(render_stats.column_walls[col]) / max_walls));
+        int bar = frame.height * render_stats.column_portals[col] / max_portals;
+        if (bar > 0) frame.drawColumn(col, frame.height - bar, frame.height - 1, RGBA{255,255,255,255});
     }
-    // Draw the ceiling and floor of the sector
-    if (wall_top > 0) main_window.drawLineRGBA(col, 0, col, wall_top, RGBA{0,255,0,255});
-    if (wall_bot < window_height) main_window.drawLineRGBA(col, window_height, col, wall_bot, RGBA{255,0,0,255});
 }
 
-int2 Engine::worldToMap(float2 world_coords) {
-    return int2{map_zoom * (world_coords - player.pos.xy())} + int2{window_width/2, window_height/2};
+int2 Engine::worldToMap(const FrameState& state, float2 world_coords) {
+    return int2{state.map_zoom * (world_coords - state.player.pos.xy())} + int2{window_width/2, window_height/2};
 }
@@ -0,0 +1,40 @@
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+FileWatcher::FileWatcher(const std::string& path) : fd(-1), wd(-1) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    file_name = slash == std::string::npos ? path : path.substr(slash + 1);
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+bool FileWatcher::changed() {
+    bool hit = false;
+#ifdef __linux__
+    if (wd < 0) return false;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t len;
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + len; ) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->len > 0 && file_name == event->name) hit = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+    return hit;
+}
@@ -0,0 +1,209 @@
+#include "FrameCapture.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+bool parseCaptureFormat(const std::string& name, CaptureFormat& format) {
+    if (name == "y4m") format = CAPTURE_Y4M;
+    else if (name == "rgba") format = CAPTURE_RGBA;
+    else return false;
+    return true;
+}
+
+FrameCapture::FrameCapture() :
+    out(nullptr), piped(false), width(0), height(0), format(CAPTURE_Y4M),
+    pushed(0), written(0), dropped(0), lost(0), stopping(false), failed(false),
+    push_seconds(0.0), write_seconds(0.0)
+{
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+}
+
+bool FrameCapture::open(const std::string& path, int width, int height, CaptureFormat format, int fps, int buffers) {
+    close();
+    if (path == "-") {
+#ifdef __linux__
+        // A stream of its own on the same descriptor, stdout may have been used already
+        int fd = dup(STDOUT_FILENO);
+        if (fd >= 0 && !(out = fdopen(fd, "wb"))) ::close(fd);
+#else
+        out = stdout;
+#endif
+    }
+    else if (!path.empty() && path[0] == '|') {
+#ifdef __linux__
+        out = popen(path.c_str() + 1, "w");
+        piped = out != nullptr;
+#endif
+    }
+    else out = std::fopen(path.c_str(), "wb");
+    if (!out) return false;
+    // Frames are written whole and only by the writer thread, nothing is left in a
+    // buffer for close() to flush from the caller's thread into a closed pipe
+    if (out != stdout) std::setvbuf(out, nullptr, _IONBF, 0);
+
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    this->buffers.assign(buffers < 1 ? 1 : buffers, std::vector<uint32_t>(size_t(width) * height));
+    pushed = written = dropped = lost = 0;
+    stopping = failed = false;
+    push_seconds = write_seconds = 0.0;
+    header.clear();
+    if (format == CAPTURE_Y4M)
+        header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" + std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n";
+    writer = std::thread(&FrameCapture::writeLoop, this);
+    return true;
+}
+
+void FrameCapture::close() {
+    if (!out) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    writer.join();
+    if (out == stdout) std::fflush(out);
+#ifdef __linux__
+    else if (piped) pclose(out);
+#endif
+    else std::fclose(out);
+    out = nullptr;
+    piped = false;
+}
+
+bool FrameCapture::push(Framebuffer& frame) {
+    auto start = std::chrono::steady_clock::now();
+    bool queued = false;
+    if (frame.width == width && frame.height == height) {
+        unsigned long slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued = !failed && pushed - written < buffers.size();
+            slot = pushed;
+        }
+        if (queued) {
+            // The writer is done with this buffer and won't look at it until pushed moves on
+            std::vector<uint32_t>& buffer = buffers[slot % buffers.size()];
+            if (!frame.swapPixels(buffer))
+                std::memcpy(buffer.data(), frame.pixels, frame.size() * sizeof(uint32_t));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pushed++;
+            }
+            cond.notify_all();
+        }
+    }
+    if (!queued) dropped++;
+    push_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return queued;
+}
+
+void FrameCapture::writeLoop() {
+#ifdef __linux__
+    // A consumer that exits would kill the whole process with SIGPIPE. Blocked here the
+    // write fails with EPIPE instead, the signal stays pending on this thread and is drained.
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+#endif
+    bool ok = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!ok) failed = true;
+    while (true) {
+        cond.wait(lock, [&] { return stopping || written < pushed; });
+        if (written == pushed) break; // stopping with nothing left to write
+        const uint32_t* pixels = buffers[written % buffers.size()].data();
+        bool skip = failed;
+        lock.unlock();
+        if (!skip) {
+            auto start = std::chrono::steady_clock::now();
+            size_t bytes = convert(pixels);
+            ok = std::fwrite(converted.data(), 1, bytes, out) == bytes;
+            write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        lock.lock();
+        // A closed pipe or full disk, this frame and everything after it is lost
+        if (skip || !ok) {
+            failed = true;
+            lost++;
+        }
+        written++;
+    }
+    lock.unlock();
+#ifdef __linux__
+    if (failed) {
+        timespec no_wait{0, 0};
+        while (sigtimedwait(&sigpipe, nullptr, &no_wait) > 0) {}
+    }
+#endif
+}
+
+// BT.601 limited range, the same integer approximation most encoders use
+static inline uint8_t lumaOf(uint32_t p) {
+    int r = p >> 16 & 0xff, g = p >> 8 & 0xff, b = p & 0xff;
+    return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+size_t FrameCapture::convert(const uint32_t* pixels) {
+    if (format == CAPTURE_RGBA) {
+        converted.resize(size_t(width) * height * 4);
+        uint8_t* dst = converted.data();
+        for (size_t i = 0, n = size_t(width) * height; i < n; i++, dst += 4) {
+            uint32_t p = pixels[i];
+            dst[0] = p >> 16;
+            dst[1] = p >> 8;
+            dst[2] = p;
+            dst[3] = p >> 24;
+        }
+        return converted.size();
+    }
+
+    // FRAME marker, full size luma, then both chroma planes averaged over 2x2 pixels
+    static const char marker[] = "FRAME\n";
+    int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    size_t luma_bytes = size_t(width) * height, chroma_bytes = size_t(chroma_width) * chroma_height;
+    converted.resize(sizeof(marker) - 1 + luma_bytes + 2 * chroma_bytes);
+    std::memcpy(converted.data(), marker, sizeof(marker) - 1);
+    uint8_t* luma = converted.data() + sizeof(marker) - 1;
+    uint8_t* cb = luma + luma_bytes;
+    uint8_t* cr = cb + chroma_bytes;
+    for (size_t i = 0; i < luma_bytes; i++)
+        luma[i] = lumaOf(pixels[i]);
+    for (int cy = 0; cy < chroma_height; cy++) {
+        const uint32_t* row0 = pixels + size_t(2 * cy) * width;
+        const uint32_t* row1 = 2 * cy + 1 < height ? row0 + width : row0;
+        for (int cx = 0; cx < chroma_width; cx++) {
+            int x0 = 2 * cx, x1 = x0 + 1 < width ? x0 + 1 : x0;
+            uint32_t quad[4] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+            int r = 0, g = 0, b = 0;
+            for (uint32_t p : quad) {
+                r += p >> 16 & 0xff;
+                g += p >> 8 & 0xff;
+                b += p & 0xff;
+            }
+            // Sums of four pixels, hence 10 instead of 8 bits of shift
+            cb[cy * chroma_width + cx] = uint8_t(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+            cr[cy * chroma_width + cx] = uint8_t(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+        }
+    }
+    return converted.size();
+}
+
+void FrameCapture::printStats() const {
+    unsigned long frames = written + dropped;
+    std::cout << "Captured " << framesWritten() << " frames, dropped " << framesDropped() << ", mean "
+              << (frames ? 1000.0 * push_seconds / frames : 0.0) << " ms queueing, "
+              << (written > lost ? 1000.0 * write_seconds / (written - lost) : 0.0) << " ms converting and writing"
+              << (failed ? ", the output stopped taking frames" : "") << std::endl;
+}
@@ -0,0 +1,65 @@
+#include "FramePipeline.h"
+#include <chrono>
+
+FramePipeline::FramePipeline(int width, int height, int frames_in_flight, RenderFunc render) :
+    frames_in_flight(frames_in_flight < 0 ? 0 : frames_in_flight),
+    render(render),
+    slots(this->frames_in_flight + 1, Slot{Framebuffer(width, height), 0.0}),
+    submitted(0), rendered(0), presented(0),
+    stopping(false)
+{
+    if (this->frames_in_flight > 0)
+        worker = std::thread(&FramePipeline::renderLoop, this);
+}
+
+FramePipeline::~FramePipeline() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        worker.join();
+    }
+}
+
+void FramePipeline::submit() {
+    // The slot is free, present() leaves at most frames_in_flight of the other slots in use
+    if (frames_in_flight == 0) {
+        slots[nextSlot()].render_seconds = renderSlot(nextSlot());
+        submitted++;
+        rendered++;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        submitted++;
+    }
+    cond.notify_all();
+}
+
+void FramePipeline::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&] { return rendered == submitted; });
+}
+
+double FramePipeline::renderSlot(int slot) {
+    auto start = std::chrono::steady_clock::now();
+    render(slot, slots[slot].frame);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FramePipeline::renderLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [&] { return stopping || rendered < submitted; });
+        if (rendered == submitted) break; // stopping with nothing left to do
+        int slot = rendered % slots.size();
+        lock.unlock();
+        double seconds = renderSlot(slot);
+        lock.lock();
+        slots[slot].render_seconds = seconds;
+        rendered++;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,97 @@
+#include "LightBake.h"
+#include "RayCast.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// Surface points are moved this far off the surface so raycasts start inside the sector
+const float BAKE_SURFACE_OFFSET = 0.01f;
+
+bool readLightFile(const std::string& path, std::vector<PointLight>& lights) {
+    std::ifstream light_file(path);
+    if (!light_file) return false;
+    std::string line;
+    std::getline(light_file, line);
+    std::istringstream n_lights_line(line);
+    int n_lights = 0;
+    n_lights_line >> n_lights;
+    lights.clear();
+    for (int i = 0; i < n_lights; i++) {
+        std::getline(light_file, line);
+        std::istringstream lines_stream(line);
+        PointLight light;
+        lines_stream >> light.pos.x >> light.pos.y >> light.pos.z >> light.intensity >> light.radius;
+        lights.push_back(light);
+    }
+    return true;
+}
+
+// Light arriving at a point of a surface with the given normal, inside sector
+static float lightAt(const RayCaster& caster, const std::vector<PointLight>& lights, float3 point, float3 normal, int sector) {
+    float sum = 0.0f;
+    for (const PointLight& light : lights) {
+        float3 to_light = light.pos - point;
+        float dist = linalg::length(to_light);
+        if (dist >= light.radius || dist == 0.0f) continue;
+        float facing = dot(normal, to_light / dist);
+        if (facing <= 0.0f) continue;
+        if (!caster.lineOfSight(point, light.pos, sector)) continue;
+        sum += light.intensity * (1.0f - dist / light.radius) * facing;
+    }
+    return sum;
+}
+
+void bakeLighting(const Map& map, const std::vector<PointLight>& lights, const BakeParams& params, MapLighting& lighting) {
+    RayCaster caster(map, params.threads);
+    WorkerPool& pool = caster.workerPool();
+    int samples = std::max(params.samples, 1);
+    lighting.walls.assign(map.walls.size(), params.ambient);
+    lighting.floors.assign(map.sectors.size(), params.ambient);
+    lighting.ceils.assign(map.sectors.size(), params.ambient);
+
+    // Every sector bakes its own walls, floor and ceiling, so no two threads write the same value
+    auto bake_sectors = [&](int begin, int end, int) {
+        for (int id = begin; id < end; id++) {
+            const Sector& sector = map.sectors[id];
+            float z_low = -sector.floor + BAKE_SURFACE_OFFSET, z_high = sector.ceil - BAKE_SURFACE_OFFSET;
+
+            for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+                const Wall& wall = map.walls[w];
+                float2 edge = map.wall_edges[w];
+                float len = linalg::length(edge);
+                if (len == 0.0f) continue;
+                // Walls go clockwise, so the inside is to the right of the edge
+                float2 inward = float2(edge.y, -edge.x) / len;
+                float sum = 0.0f;
+                for (int u = 0; u < samples; u++) {
+                    float2 p = wall.p1 + edge * ((u + 0.5f) / samples) + inward * BAKE_SURFACE_OFFSET;
+                    for (int v = 0; v < samples; v++) {
+                        float z = z_low + (z_high - z_low) * ((v + 0.5f) / samples);
+                        sum += lightAt(caster, lights, {p.x, p.y, z}, {inward.x, inward.y, 0.0f}, id);
+                    }
+                }
+                lighting.walls[w] = std::min(params.ambient + sum / (samples * samples), 1.0f);
+            }
+
+            // Floor and ceiling on a grid over the bounds, points outside the sector are skipped
+            const SectorBounds& b = map.bounds[id];
+            float floor_sum = 0.0f, ceil_sum = 0.0f;
+            int inside = 0;
+            for (int i = 0; i < samples; i++) {
+                for (int j = 0; j < samples; j++) {
+                    float2 p = b.min + (b.max - b.min) * float2((i + 0.5f) / samples, (j + 0.5f) / samples);
+                    if (!sector.containsPoint(p, map.walls)) continue;
+                    floor_sum += lightAt(caster, lights, {p.x, p.y, z_low}, {0, 0, 1}, id);
+                    ceil_sum += lightAt(caster, lights, {p.x, p.y, z_high}, {0, 0, -1}, id);
+                    inside++;
+                }
+            }
+            if (inside > 0) {
+                lighting.floors[id] = std::min(params.ambient + floor_sum / inside, 1.0f);
+                lighting.ceils[id] = std::min(params.ambient + ceil_sum / inside, 1.0f);
+            }
+        }
+    };
+    pool.parallelFor(map.sectors.size(), 1, bake_sectors);
+}
@@ -0,0 +1,283 @@
+#include "Map.h"
+#include "MapCompiler.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+bool readMapFile(const std::string& path, std::vector<Wall>& walls, std::vector<Sector>& sectors, MapLighting* lighting) {
+    std::ifstream map_file(path);
+    if (!map_file) return false;
+    std::string line;
+    std::getline(map_file, line);
+    std::istringstream n_walls_line(line);
+    int n_walls = 0;
+    n_walls_line >> n_walls;
+    walls.clear();
+    walls.reserve(n_walls);
+    for (int i = 0; i < n_walls; i++) {
+        std::getline(map_file, line);
+        std::istringstream lines_stream(line);
+        float2 p1, p2;
+        int sec_id;
+        lines_stream >> p1.x >> p1.y >> p2.x >> p2.y >> sec_id;
+        walls.push_back({p1, p2, sec_id});
+    }
+    std::getline(map_file, line);
+    std::istringstream n_secs_line(line);
+    int n_secs = 0;
+    n_secs_line >> n_secs;
+    sectors.clear();
+    sectors.reserve(n_secs);
+    for (int i = 0; i < n_secs; i++) {
+        std::getline(map_file, line);
+        std::istringstream lines_stream(line);
+        float floor, ceil;
+        int w_begin, w_end;
+        lines_stream >> floor >> ceil >> w_begin >> w_end;
+        sectors.push_back({floor, ceil, w_begin, w_end});
+    }
+    if (!lighting) return true;
+    // Lighting section: "light", a level per wall, then floor and ceiling levels per sector
+    *lighting = MapLighting();
+    if (!std::getline(map_file, line) || line.compare(0, 5, "light") != 0) return true;
+    std::vector<float> wall_light(walls.size()), floor_light(sectors.size()), ceil_light(sectors.size());
+    for (float& light : wall_light)
+        map_file >> light;
+    for (size_t i = 0; i < sectors.size(); i++)
+        map_file >> floor_light[i] >> ceil_light[i];
+    if (map_file) {
+        lighting->walls.swap(wall_light);
+        lighting->floors.swap(floor_light);
+        lighting->ceils.swap(ceil_light);
+    }
+    return true;
+}
+
+bool writeMapFile(const std::string& path, const std::vector<Wall>& walls, const std::vector<Sector>& sectors, const MapLighting* lighting) {
+    std::ofstream map_file(path);
+    if (!map_file) return false;
+    map_file.precision(9);
+    map_file << walls.size() << "\n";
+    for (const Wall& wall : walls)
+        map_file << wall.p1.x << " " << wall.p1.y << " " << wall.p2.x << " " << wall.p2.y << " " << wall.next_sector << "\n";
+    map_file << sectors.size() << "\n";
+    for (const Sector& sector : sectors)
+        map_file << sector.floor << " " << sector.ceil << " " << sector.walls_begin << " " << sector.walls_end << "\n";
+    if (lighting && !lighting->empty()) {
+        map_file << "light\n";
+        for (float light : lighting->walls)
+            map_file << light << "\n";
+        for (size_t i = 0; i < lighting->floors.size(); i++)
+            map_file << lighting->floors[i] << " " << lighting->ceils[i] << "\n";
+    }
+    return bool(map_file);
+}
+
+// Errors from validateMap mean wall ranges or portals that index outside the map
+static bool validMap(const std::vector<Wall>& walls, const std::vector<Sector>& sectors) {
+    std::vector<MapDiagnostic> diagnostics;
+    return validateMap(walls, sectors, diagnostics) == 0;
+}
+
+bool Map::load(const std::string& path) {
+    std::vector<Wall> new_walls;
+    std::vector<Sector> new_sectors;
+    MapLighting new_lighting;
+    if (!readMapFile(path, new_walls, new_sectors, &new_lighting)) return false;
+    if (!validMap(new_walls, new_sectors)) return false;
+    walls.swap(new_walls);
+    sectors.swap(new_sectors);
+    lighting = std::move(new_lighting);
+    build();
+    return true;
+}
+
+void Map::build() {
+    cells.clear();
+    dirty_flags.assign(sectors.size(), 0);
+    updated_flags.assign(sectors.size(), 0);
+    dirty.clear();
+    updated.clear();
+    // Room for every sector, so animation never grows the lists
+    dirty.reserve(sectors.size());
+    updated.reserve(sectors.size());
+    versions.assign(sectors.size(), 0);
+    bounds.assign(sectors.size(), SectorBounds{});
+    wall_edges.resize(walls.size());
+    for (size_t i = 0; i < walls.size(); i++)
+        wall_edges[i] = walls[i].p2 - walls[i].p1;
+    for (int id = 0; id < int(sectors.size()); id++)
+        buildSector(id);
+}
+
+// Walls are compared by value, a sector whose walls only moved in the wall list is unchanged
+static bool sameWalls(const std::vector<Wall>& a, const Sector& sa, const std::vector<Wall>& b, const Sector& sb) {
+    if (sa.walls_end - sa.walls_begin != sb.walls_end - sb.walls_begin) return false;
+    for (int i = 0; i <= sa.walls_end - sa.walls_begin; i++) {
+        const Wall& wa = a[sa.walls_begin + i];
+        const Wall& wb = b[sb.walls_begin + i];
+        if (wa.p1 != wb.p1 || wa.p2 != wb.p2 || wa.next_sector != wb.next_sector) return false;
+    }
+    return true;
+}
+
+int Map::reload(const std::string& path) {
+    std::vector<Wall> new_walls;
+    std::vector<Sector> new_sectors;
+    MapLighting new_lighting;
+    if (!readMapFile(path, new_walls, new_sectors, &new_lighting)) return -1;
+    // Nothing is touched until the new map checks out, a bad save keeps the old one
+    if (!validMap(new_walls, new_sectors)) return -1;
+
+    int old_count = sectors.size();
+    int new_count = new_sectors.size();
+    int common = std::min(old_count, new_count);
+
+    // Wall terms are carried over for unchanged sectors and recomputed for the rest
+    std::vector<float2> new_edges(new_walls.size());
+    std::vector<int> changed;
+    for (int id = 0; id < common; id++) {
+        const Sector& old_sec = sectors[id];
+        const Sector& new_sec = new_sectors[id];
+        if (sameWalls(walls, old_sec, new_walls, new_sec)) {
+            std::copy(wall_edges.begin() + old_sec.walls_begin, wall_edges.begin() + old_sec.walls_end + 1,
+                      new_edges.begin() + new_sec.walls_begin);
+        }
+        else {
+            unindexSector(id, bounds[id]);
+            changed.push_back(id);
+        }
+    }
+    for (int id = common; id < old_count; id++)
+        unindexSector(id, bounds[id]);
+    for (int id = common; id < new_count; id++)
+        changed.push_back(id);
+
+    for (int id : changed) {
+        const Sector& sec = new_sectors[id];
+        for (int w = sec.walls_begin; w <= sec.walls_end; w++)
+            new_edges[w] = new_walls[w].p2 - new_walls[w].p1;
+    }
+
+    walls.swap(new_walls);
+    sectors.swap(new_sectors);
+    wall_edges.swap(new_edges);
+    lighting = std::move(new_lighting);
+    bounds.resize(new_count);
+    for (int id : changed)
+        buildSector(id);
+
+    // Edits to the file replace whatever moved at runtime
+    dirty_flags.assign(new_count, 0);
+    updated_flags.assign(new_count, 0);
+    dirty.clear();
+    versions.resize(new_count, 0);
+    for (int id : changed) {
+        updated_flags[id] = DIRTY_HEIGHTS | DIRTY_WALLS;
+        versions[id]++;
+    }
+    updated.swap(changed);
+    dirty.reserve(new_count);
+    updated.reserve(new_count);
+    return updated.size();
+}
+
+void Map::markDirty(int sector, int flags) {
+    if (dirty_flags[sector] == 0) dirty.push_back(sector);
+    dirty_flags[sector] |= flags;
+}
+
+int Map::updateDirty() {
+    for (int id : dirty) {
+        if (dirty_flags[id] & DIRTY_WALLS) {
+            const Sector& sector = sectors[id];
+            for (int w = sector.walls_begin; w <= sector.walls_end; w++)
+                wall_edges[w] = walls[w].p2 - walls[w].p1;
+            SectorBounds old_bounds = bounds[id];
+            buildBounds(id);
+            // Only touch the index when the sector moved into other cells
+            if (cellRange(old_bounds) != cellRange(bounds[id])) {
+                unindexSector(id, old_bounds);
+                indexSector(id);
+            }
+        }
+        updated_flags[id] = dirty_flags[id];
+        dirty_flags[id] = 0;
+        versions[id]++;
+    }
+    // Keep both lists' capacity, steady animation doesn't allocate
+    updated.swap(dirty);
+    dirty.clear();
+    return updated.size();
+}
+
+size_t Map::memoryBytes() const {
+    size_t bytes = walls.capacity() * sizeof(Wall) + sectors.capacity() * sizeof(Sector)
+                 + bounds.capacity() * sizeof(SectorBounds) + wall_edges.capacity() * sizeof(float2)
+                 + (lighting.walls.capacity() + lighting.floors.capacity() + lighting.ceils.capacity()) * sizeof(float)
+                 + dirty_flags.capacity() + updated_flags.capacity() + versions.capacity() * sizeof(uint32_t);
+    // Hash table buckets, plus a node with a next pointer and a vector per cell
+    bytes += cells.bucket_count() * sizeof(void*);
+    for (const auto& cell : cells)
+        bytes += sizeof(void*) + sizeof(cell) + cell.second.capacity() * sizeof(int);
+    return bytes;
+}
+
+int Map::locateSector(float2 point) const {
+    int cx = int(std::floor(point.x / MAP_CELL_SIZE));
+    int cy = int(std::floor(point.y / MAP_CELL_SIZE));
+    auto cell = cells.find(cellKey(cx, cy));
+    if (cell == cells.end()) return -1;
+    for (int id : cell->second) {
+        if (bounds[id].containsPoint(point) && sectors[id].containsPoint(point, walls))
+            return id;
+    }
+    return -1;
+}
+
+void Map::buildSector(int id) {
+    buildBounds(id);
+    indexSector(id);
+}
+
+void Map::buildBounds(int id) {
+    const Sector& sector = sectors[id];
+    SectorBounds b{{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+    for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+        b.min = linalg::min(b.min, linalg::min(walls[w].p1, walls[w].p2));
+        b.max = linalg::max(b.max, linalg::max(walls[w].p1, walls[w].p2));
+    }
+    bounds[id] = b;
+}
+
+int4 Map::cellRange(const SectorBounds& b) {
+    if (b.min.x > b.max.x) return {0, 0, -1, -1};
+    return {int(std::floor(b.min.x / MAP_CELL_SIZE)), int(std::floor(b.min.y / MAP_CELL_SIZE)),
+            int(std::floor(b.max.x / MAP_CELL_SIZE)), int(std::floor(b.max.y / MAP_CELL_SIZE))};
+}
+
+void Map::indexSector(int id) {
+    const SectorBounds& b = bounds[id];
+    if (b.min.x > b.max.x) return; // sector without walls
+    for (int cy = int(std::floor(b.min.y / MAP_CELL_SIZE)); cy <= int(std::floor(b.max.y / MAP_CELL_SIZE)); cy++)
+        for (int cx = int(std::floor(b.min.x / MAP_CELL_SIZE)); cx <= int(std::floor(b.max.x / MAP_CELL_SIZE)); cx++)
+            cells[cellKey(cx, cy)].push_back(id);
+}
+
+void Map::unindexSector(int id, const SectorBounds& b) {
+    if (b.min.x > b.max.x) return;
+    for (int cy = int(std::floor(b.min.y / MAP_CELL_SIZE)); cy <= int(std::floor(b.max.y / MAP_CELL_SIZE)); cy++) {
+        for (int cx = int(std::floor(b.min.x / MAP_CELL_SIZE)); cx <= int(std::floor(b.max.x / MAP_CELL_SIZE)); cx++) {
+            auto cell = cells.find(cellKey(cx, cy));
+            if (cell == cells.end()) continue;
+            // Empty cells stay, a sector moving back and forth between cells doesn't allocate
+            cell->second.erase(std::remove(cell->second.begin(), cell->second.end(), id), cell->second.end());
+        }
+    }
+}
+
+long long Map::cellKey(int cx, int cy) {
+    // Shifted as unsigned, shifting a negative index is undefined
+    return (long long)((unsigned long long)(unsigned int)cx << 32 | (unsigned int)cy);
+}
@@ -0,0 +1,229 @@
+#include "MapCompiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+
+static void report(std::vector<MapDiagnostic>& diagnostics, bool error, int sector, int wall, const std::string& message) {
+    diagnostics.push_back({error, sector, wall, message});
+}
+
+int validateMap(const std::vector<Wall>& walls, const std::vector<Sector>& sectors, std::vector<MapDiagnostic>& diagnostics) {
+    size_t first = diagnostics.size();
+    int n_walls = walls.size(), n_sectors = sectors.size();
+
+    // Wall ranges, walls claimed by more than one sector or by none
+    std::vector<int> owner(n_walls, -1);
+    std::vector<bool> valid(n_sectors, false);
+    for (int id = 0; id < n_sectors; id++) {
+        const Sector& sector = sectors[id];
+        std::ostringstream message;
+        if (sector.walls_begin < 0 || sector.walls_end >= n_walls || sector.walls_begin > sector.walls_end) {
+            message << "wall range " << sector.walls_begin << ".." << sector.walls_end << " is outside the " << n_walls << " walls or empty";
+            report(diagnostics, true, id, -1, message.str());
+            continue;
+        }
+        if (sector.walls_end - sector.walls_begin < 2) {
+            message << "has only " << sector.walls_end - sector.walls_begin + 1 << " walls";
+            report(diagnostics, true, id, -1, message.str());
+        }
+        valid[id] = true;
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+            if (owner[w] < 0) {
+                owner[w] = id;
+            }
+            else if (valid[id]) {
+                // Once per sector, the rest of the overlap is the same mistake
+                std::ostringstream overlap;
+                overlap << "wall range overlaps sector " << owner[w];
+                report(diagnostics, true, id, w, overlap.str());
+                valid[id] = false;
+            }
+        }
+    }
+    // An error rather than a warning, reorderMap lays out walls by sector and would drop it
+    for (int w = 0; w < n_walls; w++)
+        if (owner[w] < 0) report(diagnostics, true, -1, w, "belongs to no sector");
+
+    std::vector<bool> used;
+    for (int id = 0; id < n_sectors; id++) {
+        if (!valid[id]) continue;
+        const Sector& sector = sectors[id];
+
+        // Closed: following each wall to the one that starts where it ends leads from
+        // walls_begin through every wall of the sector and back, so two loops don't pass
+        int count = sector.walls_end - sector.walls_begin + 1, walked = 0, at = sector.walls_begin;
+        used.assign(count, false);
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++)
+            if (walls[w].p1 == walls[w].p2) report(diagnostics, false, id, w, "has zero length");
+        for (;;) {
+            used[at - sector.walls_begin] = true;
+            walked++;
+            int next = -1;
+            for (int w = sector.walls_begin; w <= sector.walls_end && next < 0; w++)
+                if (!used[w - sector.walls_begin] && walls[w].p1 == walls[at].p2) next = w;
+            if (next < 0) break;
+            at = next;
+        }
+        bool looped = walls[at].p2 == walls[sector.walls_begin].p1;
+        bool closed = looped && walked == count;
+        if (!closed) {
+            std::ostringstream message;
+            if (looped)
+                message << "is not one loop, wall " << sector.walls_begin << " closes a loop of " << walked << " of its " << count << " walls";
+            else
+                message << "is not closed, no wall starts where wall " << at << " ends at (" << walls[at].p2.x << ", " << walls[at].p2.y << ")";
+            report(diagnostics, true, id, -1, message.str());
+        }
+
+        // Clockwise with y up has a negative signed area
+        double area = 0.0;
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++)
+            area += double(walls[w].p1.x) * walls[w].p2.y - double(walls[w].p2.x) * walls[w].p1.y;
+        if (closed && area >= 0.0)
+            report(diagnostics, true, id, -1, area == 0.0 ? "has no area" : "winds counter-clockwise, its walls face outwards");
+
+        // Two-sided portals
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+            int next = walls[w].next_sector;
+            if (next < 0) continue;
+            std::ostringstream message;
+            if (next >= n_sectors) {
+                message << "portal to sector " << next << " which doesn't exist";
+                report(diagnostics, true, id, w, message.str());
+                continue;
+            }
+            if (next == id) {
+                report(diagnostics, true, id, w, "portal leads back into its own sector");
+                continue;
+            }
+            if (!valid[next]) continue;
+            int back = -1;
+            for (int b = sectors[next].walls_begin; b <= sectors[next].walls_end; b++)
+                if (walls[b].p1 == walls[w].p2 && walls[b].p2 == walls[w].p1) back = b;
+            if (back < 0)
+                message << "portal to sector " << next << " has no matching wall in it";
+            else if (walls[back].next_sector != id)
+                message << "portal to sector " << next << " is one-sided, wall " << back << " leads to "
+                        << (walls[back].next_sector < 0 ? std::string("nothing") : "sector " + std::to_string(walls[back].next_sector));
+            if (!message.str().empty()) report(diagnostics, true, id, w, message.str());
+        }
+    }
+
+    int errors = 0;
+    for (size_t i = first; i < diagnostics.size(); i++)
+        errors += diagnostics[i].error;
+    return errors;
+}
+
+bool parseSectorOrder(const std::string& name, SectorOrder& order) {
+    if (name == "bfs")              order = ORDER_BFS;
+    else if (name == "hilbert")     order = ORDER_HILBERT;
+    else return false;
+    return true;
+}
+
+// Distance along a Hilbert curve filling a 2^16 x 2^16 grid
+static uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+        d += uint64_t(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve stays connected
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return d;
+}
+
+std::vector<int> sectorOrder(const std::vector<Wall>& walls, const std::vector<Sector>& sectors, SectorOrder order) {
+    int n = sectors.size();
+    std::vector<int> result;
+    result.reserve(n);
+    if (order == ORDER_BFS) {
+        // Every unconnected part starts a search of its own
+        std::vector<bool> seen(n, false);
+        for (int start = 0; start < n; start++) {
+            if (seen[start]) continue;
+            seen[start] = true;
+            size_t head = result.size();
+            result.push_back(start);
+            while (head < result.size()) {
+                const Sector& sector = sectors[result[head++]];
+                for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+                    int next = walls[w].next_sector;
+                    if (next >= 0 && next < n && !seen[next]) {
+                        seen[next] = true;
+                        result.push_back(next);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    // Centres of the sector bounds, scaled onto the curve's grid
+    std::vector<float2> centres(n, float2(0, 0));
+    float2 lo{INFINITY, INFINITY}, hi{-INFINITY, -INFINITY};
+    for (int id = 0; id < n; id++) {
+        const Sector& sector = sectors[id];
+        float2 b_lo{INFINITY, INFINITY}, b_hi{-INFINITY, -INFINITY};
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+            b_lo = linalg::min(b_lo, walls[w].p1);
+            b_hi = linalg::max(b_hi, walls[w].p1);
+        }
+        if (b_lo.x > b_hi.x) continue;
+        centres[id] = (b_lo + b_hi) * 0.5f;
+        lo = linalg::min(lo, centres[id]);
+        hi = linalg::max(hi, centres[id]);
+    }
+    float scale = 65535.0f / std::max(std::max(hi.x - lo.x, hi.y - lo.y), 1e-6f);
+    std::vector<std::pair<uint64_t, int>> keys(n);
+    for (int id = 0; id < n; id++) {
+        float2 g = linalg::clamp((centres[id] - lo) * scale, float2(0, 0), float2(65535, 65535));
+        keys[id] = {hilbertIndex(uint32_t(g.x), uint32_t(g.y)), id};
+    }
+    std::sort(keys.begin(), keys.end());
+    for (const auto& key : keys)
+        result.push_back(key.second);
+    return result;
+}
+
+void reorderMap(const std::vector<int>& order, std::vector<Wall>& walls, std::vector<Sector>& sectors, MapLighting* lighting) {
+    std::vector<int> new_id(sectors.size(), -1);
+    for (size_t i = 0; i < order.size(); i++)
+        new_id[order[i]] = i;
+    bool lit = lighting && !lighting->empty();
+
+    std::vector<Wall> new_walls;
+    std::vector<Sector> new_sectors;
+    MapLighting new_lighting;
+    new_walls.reserve(walls.size());
+    new_sectors.reserve(sectors.size());
+    for (int old : order) {
+        Sector sector = sectors[old];
+        int begin = new_walls.size();
+        for (int w = sector.walls_begin; w <= sector.walls_end; w++) {
+            Wall wall = walls[w];
+            if (wall.next_sector >= 0 && wall.next_sector < int(new_id.size())) wall.next_sector = new_id[wall.next_sector];
+            new_walls.push_back(wall);
+            if (lit) new_lighting.walls.push_back(lighting->walls[w]);
+        }
+        sector.walls_begin = begin;
+        sector.walls_end = int(new_walls.size()) - 1;
+        new_sectors.push_back(sector);
+        if (lit) {
+            new_lighting.floors.push_back(lighting->floors[old]);
+            new_lighting.ceils.push_back(lighting->ceils[old]);
+        }
+    }
+    walls.swap(new_walls);
+    sectors.swap(new_sectors);
+    if (lit) *lighting = std::move(new_lighting);
+}
@@ -0,0 +1,146 @@
+#include "MapGen.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Small portable generator, std::uniform_*_distribution differs between standard libraries
+struct Random {
+    uint64_t state;
+    explicit Random(unsigned int seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return uint32_t(state >> 32);
+    }
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+    int below(int n) { return int(next() % uint32_t(n)); }
+};
+
+enum Side { SIDE_LEFT, SIDE_TOP, SIDE_RIGHT, SIDE_BOTTOM };
+
+struct Room {
+    int cx, cy;
+    int neighbour[4];   // Sector on the other side of each side's portal, or -1
+};
+
+static void link(std::vector<Room>& rooms, int a, Side side, int b) {
+    static const Side opposite[4] = {SIDE_RIGHT, SIDE_BOTTOM, SIDE_LEFT, SIDE_TOP};
+    rooms[a].neighbour[side] = b;
+    rooms[b].neighbour[opposite[side]] = a;
+}
+
+// Index of the room next to room i, or -1
+static int adjacent(int i, Side side, int width, int count) {
+    int cx = i % width;
+    switch (side) {
+    case SIDE_LEFT :    return cx > 0 ? i - 1 : -1;
+    case SIDE_RIGHT :   return cx + 1 < width && i + 1 < count ? i + 1 : -1;
+    case SIDE_TOP :     return i + width < count ? i + width : -1;
+    case SIDE_BOTTOM :  return i >= width ? i - width : -1;
+    }
+    return -1;
+}
+
+// Walls go clockwise (y up), like the hand made maps. Every side is split into k
+// unit segments and the portal is always the segment at offset k/2 from the lower
+// coordinate, so both rooms produce the exact same endpoints for it.
+static void emitRoom(const Room& room, int k, float unit, std::vector<Wall>& walls, std::vector<Sector>& sectors, Random& random) {
+    int x0 = room.cx * k, y0 = room.cy * k, x1 = x0 + k, y1 = y0 + k;
+    int portal = k / 2;
+    int begin = walls.size();
+    auto wall = [&](int ax, int ay, int bx, int by, int next) {
+        walls.push_back({{ax * unit, ay * unit}, {bx * unit, by * unit}, next});
+    };
+    for (int j = 0; j < k; j++) wall(x0, y0 + j, x0, y0 + j + 1, j == portal ? room.neighbour[SIDE_LEFT] : -1);
+    for (int j = 0; j < k; j++) wall(x0 + j, y1, x0 + j + 1, y1, j == portal ? room.neighbour[SIDE_TOP] : -1);
+    for (int j = 0; j < k; j++) wall(x1, y1 - j, x1, y1 - j - 1, k - 1 - j == portal ? room.neighbour[SIDE_RIGHT] : -1);
+    for (int j = 0; j < k; j++) wall(x1 - j, y0, x1 - j - 1, y0, k - 1 - j == portal ? room.neighbour[SIDE_BOTTOM] : -1);
+    float floor = 0.5f + 0.5f * random.uniform();
+    float ceil = 0.8f + 0.7f * random.uniform();
+    sectors.push_back({floor, ceil, begin, int(walls.size()) - 1});
+}
+
+void generateMap(const MapGenParams& params, std::vector<Wall>& walls, std::vector<Sector>& sectors) {
+    walls.clear();
+    sectors.clear();
+    Random random(params.seed);
+
+    if (params.layout == LAYOUT_OPEN) {
+        int n = std::max(params.walls_per_sector, 3);
+        float radius = params.room_size * n / (2 * 3.14159265f);
+        walls.reserve(n);
+        for (int i = 0; i < n; i++) {
+            // Angles decrease so the walls go clockwise
+            float a1 = -2 * 3.14159265f * i / n, a2 = -2 * 3.14159265f * ((i + 1) % n) / n;
+            walls.push_back({{radius * std::cos(a1), radius * std::sin(a1)}, {radius * std::cos(a2), radius * std::sin(a2)}, -1});
+        }
+        sectors.push_back({1.0f, 1.5f, 0, n - 1});
+        return;
+    }
+
+    int count = std::max(params.sectors, 1);
+    int width = params.layout == LAYOUT_CORRIDOR ? count : int(std::ceil(std::sqrt(double(count))));
+    std::vector<Room> rooms(count);
+    for (int i = 0; i < count; i++)
+        rooms[i] = {i % width, i / width, {-1, -1, -1, -1}};
+
+    switch (params.layout) {
+    case LAYOUT_CORRIDOR :
+        for (int i = 0; i + 1 < count; i++)
+            link(rooms, i, SIDE_RIGHT, i + 1);
+        break;
+    case LAYOUT_MAZE : {
+        // Randomized depth first search, every room ends up reachable
+        std::vector<bool> seen(count, false);
+        std::vector<int> stack{0};
+        seen[0] = true;
+        while (!stack.empty()) {
+            int i = stack.back();
+            int options[4], n = 0;
+            for (int side = 0; side < 4; side++) {
+                int j = adjacent(i, Side(side), width, count);
+                if (j >= 0 && !seen[j]) options[n++] = side;
+            }
+            if (n == 0) {
+                stack.pop_back();
+                continue;
+            }
+            Side side = Side(options[random.below(n)]);
+            int j = adjacent(i, side, width, count);
+            link(rooms, i, side, j);
+            seen[j] = true;
+            stack.push_back(j);
+        }
+        // Then add loops like a grid
+        [[fallthrough]];
+    }
+    case LAYOUT_GRID :
+        for (int i = 0; i < count; i++) {
+            for (Side side : {SIDE_RIGHT, SIDE_TOP}) {
+                int j = adjacent(i, side, width, count);
+                if (j >= 0 && rooms[i].neighbour[side] < 0 && random.uniform() < params.portal_density)
+                    link(rooms, i, side, j);
+            }
+        }
+        break;
+    case LAYOUT_OPEN :
+        break;
+    }
+
+    int k = std::max(params.walls_per_sector / 4, 1);
+    float unit = params.room_size / k;
+    walls.reserve(size_t(count) * 4 * k);
+    sectors.reserve(count);
+    for (const Room& room : rooms)
+        emitRoom(room, k, unit, walls, sectors, random);
+}
+
+bool parseLayout(const std::string& name, MapLayout& layout) {
+    if (name == "grid")             layout = LAYOUT_GRID;
+    else if (name == "maze")        layout = LAYOUT_MAZE;
+    else if (name == "corridor")    layout = LAYOUT_CORRIDOR;
+    else if (name == "open")        layout = LAYOUT_OPEN;
+    else return false;
+    return true;
+}
@@ -0,0 +1,113 @@
+#include "PerfHud.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Rows of the 3x5 glyphs top to bottom, bit 2 is the left pixel
+static const unsigned char DIGIT_GLYPHS[10][5] = {
+    {7,5,5,5,7}, {2,6,2,2,7}, {7,1,7,4,7}, {7,1,7,1,7}, {5,5,7,1,1},
+    {7,4,7,1,7}, {7,4,7,5,7}, {7,1,1,1,1}, {7,5,7,5,7}, {7,5,7,1,7}
+};
+static const unsigned char LETTER_GLYPHS[26][5] = {
+    {2,5,7,5,5}, {6,5,6,5,6}, {3,4,4,4,3}, {6,5,5,5,6}, {7,4,6,4,7}, {7,4,6,4,4}, {3,4,5,5,3},
+    {5,5,7,5,5}, {7,2,2,2,7}, {1,1,1,5,2}, {5,5,6,5,5}, {4,4,4,4,7}, {5,7,7,5,5}, {6,5,5,5,5},
+    {2,5,5,5,2}, {6,5,6,4,4}, {2,5,5,6,3}, {6,5,6,5,5}, {3,4,2,1,6}, {7,2,2,2,2}, {5,5,5,5,7},
+    {5,5,5,5,2}, {5,5,7,7,5}, {5,5,2,5,5}, {5,5,2,2,2}, {7,1,2,4,7}
+};
+
+static const unsigned char* glyph(char c) {
+    static const unsigned char dot[5] = {0,0,0,0,2}, colon[5] = {0,2,0,2,0}, slash[5] = {1,1,2,4,4},
+                               percent[5] = {5,1,2,4,5}, dash[5] = {0,0,7,0,0};
+    if (c >= '0' && c <= '9') return DIGIT_GLYPHS[c - '0'];
+    if (c >= 'a' && c <= 'z') return LETTER_GLYPHS[c - 'a'];
+    if (c >= 'A' && c <= 'Z') return LETTER_GLYPHS[c - 'A'];
+    switch (c) {
+    case '.' : return dot;
+    case ':' : return colon;
+    case '/' : return slash;
+    case '%' : return percent;
+    case '-' : return dash;
+    }
+    return nullptr;
+}
+
+int drawText(Framebuffer& frame, int x, int y, const char* text, RGBA clr, int scale) {
+    uint32_t c = Framebuffer::pack(clr);
+    for (; *text; text++, x += 4 * scale) {
+        const unsigned char* rows = glyph(*text);
+        if (!rows) continue;
+        for (int row = 0; row < 5 * scale; row++) {
+            int py = y + row;
+            if (py < 0 || py >= frame.height) continue;
+            unsigned char bits = rows[row / scale];
+            for (int col = 0; col < 3 * scale; col++) {
+                int px = x + col;
+                if ((bits >> (2 - col / scale) & 1) && px >= 0 && px < frame.width)
+                    frame.pixels[py * frame.width + px] = c;
+            }
+        }
+    }
+    return x;
+}
+
+// Halves the brightness of a rectangle so text stays readable over any view
+static void darken(Framebuffer& frame, int x1, int y1, int x2, int y2) {
+    x2 = std::min(x2, frame.width);
+    y2 = std::min(y2, frame.height);
+    for (int y = std::max(y1, 0); y < y2; y++)
+        for (uint32_t* p = frame.pixels + y * frame.width + std::max(x1, 0), *end = frame.pixels + y * frame.width + x2; p < end; p++)
+            *p = 0xff000000 | (*p >> 1 & 0x7f7f7f);
+}
+
+PerfHud::PerfHud() : history(), count(0), next(0), draw_ms(0.0f) {}
+
+void PerfHud::record(const FrameTimes& times) {
+    history[next] = times;
+    next = (next + 1) % HUD_HISTORY;
+    count = std::min(count + 1, HUD_HISTORY);
+}
+
+void PerfHud::draw(Framebuffer& frame) {
+    auto start = std::chrono::steady_clock::now();
+    const int margin = 4, line = 12, graph_height = 60;
+    const float graph_ms = 50.0f;   // Top of the graph
+    const int text_lines = 3, text_width = 48 * 8;    // Longest line at the default scale
+    darken(frame, 0, 0, std::max(HUD_HISTORY, text_width) + 2 * margin, 2 * margin + text_lines * line + graph_height);
+    if (count == 0) return;
+
+    // Percentiles of the frame times in the graph
+    std::array<float, HUD_HISTORY> sorted;
+    for (int i = 0; i < count; i++)
+        sorted[i] = history[i].frame_ms;
+    auto percentile = [&](float p) {
+        int k = std::min(count - 1, int(p * count));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + count);
+        return sorted[k];
+    };
+    const FrameTimes& last = history[(next + HUD_HISTORY - 1) % HUD_HISTORY];
+    const RGBA white{255, 255, 255, 255};
+    char text[96];
+    std::snprintf(text, sizeof(text), "frame %.1f ms p50 %.1f p95 %.1f p99 %.1f",
+                  last.frame_ms, percentile(0.5f), percentile(0.95f), percentile(0.99f));
+    drawText(frame, margin, margin, text, white);
+    std::snprintf(text, sizeof(text), "render %.2f event %.2f present %.2f hud %.2f",
+                  last.render_ms, last.event_ms, last.present_ms, draw_ms);
+    drawText(frame, margin, margin + line, text, white);
+    std::snprintf(text, sizeof(text), "walls %lu portals %lu%s", last.walls_tested, last.portals_crossed,
+                  last.partial ? " half frame" : "");
+    drawText(frame, margin, margin + 2 * line, text, white);
+
+    // Oldest frame on the left, green within 60 Hz, yellow within 30 Hz, red above
+    int base = margin + text_lines * line + graph_height;
+    for (int i = 0; i < count; i++) {
+        float ms = history[(next - count + i + HUD_HISTORY) % HUD_HISTORY].frame_ms;
+        int bar = std::min(graph_height, int(ms / graph_ms * graph_height));
+        RGBA clr = ms <= 1000.0f / 60 ? RGBA{0, 255, 0, 255} : ms <= 1000.0f / 30 ? RGBA{255, 255, 0, 255} : RGBA{255, 0, 0, 255};
+        if (bar > 0) frame.drawColumn(margin + HUD_HISTORY - count + i, base - bar + 1, base, clr);
+    }
+    int target = base - int(1000.0f / 60 / graph_ms * graph_height);
+    for (int x = margin; x < margin + HUD_HISTORY && target >= 0 && target < frame.height && x < frame.width; x += 2)
+        frame.pixels[target * frame.width + x] = 0xffffffff;
+
+    draw_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
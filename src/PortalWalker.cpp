@@ -0,0 +1,57 @@
+#include "PortalWalker.h"
+#include <algorithm>
+#include <cmath>
+
+void PortalWalker::prepare(int sector_count) {
+    if (visited.size() != size_t(sector_count)) {
+        visited.assign(sector_count, 0);
+        visit_stamp = 0;
+    }
+}
+
+int PortalWalker::walk(const Map& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps) {
+    return walkRay(map, player, radians, sector_id, max_depth, steps);
+}
+
+int PortalWalker::walk(const CompactMap& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps) {
+    return walkRay(map, player, radians, sector_id, max_depth, steps);
+}
+
+template<class M> int PortalWalker::walkRay(const M& map, const Player& player, float radians, int sector_id, int max_depth, PortalStep* steps) {
+    Ray camera_ray({player.pos.xy(), {float(cos(radians)), float(sin(radians))} });
+    float cos_view = cos(radians - player.angle);
+
+    // New stamp for this ray, clear the stamps when it wraps around
+    if (++visit_stamp == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        visit_stamp = 1;
+    }
+
+    int depth = 0;
+    steps[0].sector = sector_id;
+    while (true) {
+        PortalStep& step = steps[depth];
+        visited[step.sector] = visit_stamp;
+
+        // Find nearest intersection in sectors walls
+        step.dist = INFINITY;
+        step.wall = -1;
+        for (int id = map.wallsBegin(step.sector), end = map.wallsEnd(step.sector); id <= end; id++) {
+            float2 intersection_point;
+            if (cross(camera_ray.direction, map.wallEdge(id)) <= 0 && map.wall(id).rayIntersect(camera_ray, &intersection_point)) {
+                float dist_euc = sqrt((player.pos.x-intersection_point.x)*(player.pos.x-intersection_point.x) + (player.pos.y-intersection_point.y)*(player.pos.y-intersection_point.y));
+                float dist_flat = dist_euc * cos_view;
+                if (dist_flat < step.dist) {
+                    step.dist = dist_flat;
+                    step.wall = id;
+                }
+            }
+        }
+
+        if (step.wall < 0 || depth == max_depth) break;
+        int next = map.nextSector(step.wall);
+        if (next < 0 || visited[next] == visit_stamp) break;
+        steps[++depth].sector = next;
+    }
+    return depth;
+}
@@ -0,0 +1,140 @@
+#include "RayCast.h"
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+RayCaster::RayCaster(const Map& map, int threads) :
+    map(map),
+    pool(threads)
+{
+    rebuild();
+}
+
+void RayCaster::rebuild() {
+    size_t n = map.walls.size();
+    x1.resize(n);
+    y1.resize(n);
+    ex.resize(n);
+    ey.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        x1[i] = map.walls[i].p1.x;
+        y1[i] = map.walls[i].p1.y;
+        ex[i] = map.wall_edges[i].x;
+        ey[i] = map.wall_edges[i].y;
+    }
+}
+
+void RayCaster::update(const std::vector<int>& sectors) {
+    for (int id : sectors) {
+        if (!(map.updatedFlags(id) & DIRTY_WALLS)) continue;
+        const Sector& sector = map.sectors[id];
+        for (int i = sector.walls_begin; i <= sector.walls_end; i++) {
+            x1[i] = map.walls[i].p1.x;
+            y1[i] = map.walls[i].p1.y;
+            ex[i] = map.wall_edges[i].x;
+            ey[i] = map.wall_edges[i].y;
+        }
+    }
+}
+
+// Solves origin + t * dir = p1 + s * edge. Only walls crossed from the inside of
+// the sector count (denom < 0, the renderer's front faces), which also skips the
+// other side of the portal the ray came in through. The SSE path does the same
+// operations in the same order, so both give identical results.
+int RayCaster::exitWall(const Sector& sector, float2 origin, float2 dir, float t_min, float& t_exit) const {
+    int best = -1;
+    float best_t = INFINITY;
+    int i = sector.walls_begin;
+    int end = sector.walls_end + 1;
+#ifdef __SSE2__
+    const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y);
+    const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), tmin = _mm_set1_ps(t_min);
+    for (; i + 4 <= end; i += 4) {
+        __m128 rx = _mm_sub_ps(_mm_loadu_ps(&x1[i]), ox);
+        __m128 ry = _mm_sub_ps(_mm_loadu_ps(&y1[i]), oy);
+        __m128 wx = _mm_loadu_ps(&ex[i]), wy = _mm_loadu_ps(&ey[i]);
+        __m128 denom = _mm_sub_ps(_mm_mul_ps(dx, wy), _mm_mul_ps(dy, wx));
+        __m128 t = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(rx, wy), _mm_mul_ps(ry, wx)), denom);
+        __m128 s = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(rx, dy), _mm_mul_ps(ry, dx)), denom);
+        __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(denom, zero), _mm_cmpge_ps(t, tmin)),
+                                _mm_and_ps(_mm_cmpge_ps(s, zero), _mm_cmple_ps(s, one)));
+        int mask = _mm_movemask_ps(_mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(best_t))));
+        if (mask == 0) continue;
+        alignas(16) float ts[4];
+        _mm_store_ps(ts, t);
+        for (int lane = 0; lane < 4; lane++) {
+            if ((mask >> lane & 1) && ts[lane] < best_t) {
+                best_t = ts[lane];
+                best = i + lane;
+            }
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        float rx = x1[i] - origin.x, ry = y1[i] - origin.y;
+        float denom = dir.x * ey[i] - dir.y * ex[i];
+        float t = (rx * ey[i] - ry * ex[i]) / denom;
+        float s = (rx * dir.y - ry * dir.x) / denom;
+        if (denom < 0 && t >= t_min && s >= 0 && s <= 1 && t < best_t) {
+            best_t = t;
+            best = i;
+        }
+    }
+    t_exit = best_t;
+    return best;
+}
+
+RayHit RayCaster::cast(const RaySegment& ray) const {
+    float3 delta = ray.to - ray.from;
+    float length = linalg::length(delta);
+    auto hitAt = [&](HitType type, int sector, int wall, float t) {
+        return RayHit{type, sector, wall, ray.from + t * delta, t * length};
+    };
+
+    int sector_id = ray.sector >= 0 ? ray.sector : map.locateSector(ray.from.xy());
+    if (sector_id < 0) return RayHit{HIT_OUTSIDE, -1, -1, ray.from, 0.0f};
+
+    float t_in = 0.0f;
+    int entry_wall = -1;
+    // Every sector is entered at most once along a straight line, this only guards against broken maps
+    for (size_t steps = 0; steps <= map.sectors.size(); steps++) {
+        const Sector& sector = map.sectors[sector_id];
+        float z_low = -sector.floor, z_high = sector.ceil;
+
+        // Entered through a portal below its floor or above its ceiling
+        float z_in = ray.from.z + t_in * delta.z;
+        if (z_in < z_low || z_in > z_high) {
+            if (entry_wall >= 0) return hitAt(HIT_WALL, sector_id, entry_wall, t_in);
+            return hitAt(z_in < z_low ? HIT_FLOOR : HIT_CEILING, sector_id, -1, 0.0f);
+        }
+
+        float t_exit;
+        int wall = exitWall(sector, ray.from.xy(), delta.xy(), t_in, t_exit);
+        float t_end = std::min(t_exit, 1.0f);
+
+        // Heights are linear in t, so checking the end of the span inside this sector is enough
+        float z_end = ray.from.z + t_end * delta.z;
+        if (z_end < z_low) return hitAt(HIT_FLOOR, sector_id, -1, (z_low - ray.from.z) / delta.z);
+        if (z_end > z_high) return hitAt(HIT_CEILING, sector_id, -1, (z_high - ray.from.z) / delta.z);
+
+        if (wall < 0 || t_exit > 1.0f) return hitAt(HIT_NONE, sector_id, -1, 1.0f);
+        int next = map.walls[wall].next_sector;
+        if (next < 0) return hitAt(HIT_WALL, sector_id, wall, t_exit);
+
+        sector_id = next;
+        entry_wall = wall;
+        t_in = t_exit;
+    }
+    return hitAt(HIT_WALL, sector_id, entry_wall, t_in);
+}
+
+void RayCaster::castBatch(const RaySegment* rays, RayHit* hits, int count) {
+    auto cast_rays = [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++)
+            hits[i] = cast(rays[i]);
+    };
+    pool.parallelFor(count, CHUNK, cast_rays);
+}
@@ -0,0 +1,422 @@
+#include "RenderServer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <list>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Frames are never bigger than this many pixels, keeps a bad setup from asking for terabytes
+const uint64_t RENDER_MAX_PIXELS = 1ull << 32;
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+
+// Reads or writes exactly size bytes, false if the other end went away
+static bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+#endif
+
+struct RenderServer::Connection {
+    int fd;
+    std::mutex send_mutex;      // Setup replies and frame replies come from different threads
+    // Frame memory shared with the client
+    uint8_t* memory;
+    size_t memory_bytes;
+    uint32_t slots, max_cameras, width, height;
+    uint64_t slot_bytes;
+    int pending;                // Requests queued or being rendered, guarded by the server mutex
+    std::atomic<bool> closed;   // The reader stopped, set as the last thing it does
+
+    Connection(int fd) : fd(fd), memory(nullptr), memory_bytes(0), slots(0), max_cameras(0), width(0), height(0), slot_bytes(0), pending(0), closed(false) {}
+    ~Connection() {
+#ifdef __linux__
+        if (memory) munmap(memory, memory_bytes);
+        close(fd);
+#endif
+    }
+};
+
+RenderServer::RenderServer(const Map& map, int threads, int max_portal_depth) :
+    map(map),
+    batch(threads, max_portal_depth),
+    listen_fd(-1),
+    stopping(false),
+    finished(false),
+    queue_total_ns(0), render_total_ns(0)
+{
+}
+
+RenderServer::~RenderServer() {
+#ifdef __linux__
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+#endif
+}
+
+bool RenderServer::listen(const std::string& path) {
+#ifdef __linux__
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::strcpy(address.sun_path, path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) return false;
+    unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listen_fd, 16) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    socket_path = path;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void RenderServer::run(const volatile int* stop_flag) {
+#ifdef __linux__
+    if (listen_fd < 0) return;
+    finished = false;
+    render_thread = std::thread(&RenderServer::renderJobs, this);
+    struct Reader {
+        std::shared_ptr<Connection> connection;
+        std::thread thread;
+    };
+    std::list<Reader> readers;
+    while (!stopping && !(stop_flag && *stop_flag)) {
+        // Reap clients that went away. Queued jobs hold the connection too, the last
+        // one to let go unmaps the frame memory and closes the socket once pending is 0.
+        for (auto reader = readers.begin(); reader != readers.end();) {
+            if (!reader->connection->closed) {
+                ++reader;
+                continue;
+            }
+            reader->thread.join();
+            reader = readers.erase(reader);
+        }
+
+        // Wake up now and then to notice stop requests
+        pollfd listening{listen_fd, POLLIN, 0};
+        if (poll(&listening, 1, 100) <= 0) continue;
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd);
+        readers.push_back({connection, std::thread(&RenderServer::readRequests, this, connection)});
+    }
+    // Unblock the readers, then let the render thread finish what was queued
+    for (Reader& reader : readers)
+        shutdown(reader.connection->fd, SHUT_RD);
+    for (Reader& reader : readers)
+        reader.thread.join();
+    readers.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    job_cond.notify_all();
+    render_thread.join();
+#else
+    (void)stop_flag;
+#endif
+}
+
+void RenderServer::readRequests(std::shared_ptr<Connection> connection) {
+#ifdef __linux__
+    RenderHeader header;
+    while (readAll(connection->fd, &header, sizeof(header))) {
+        if (header.magic != RENDER_MAGIC) break;
+        if (header.type == RENDER_SETUP) {
+            RenderSetup request;
+            if (!readAll(connection->fd, &request, sizeof(request))) break;
+            // Frames in flight would be drawn into memory that goes away
+            std::unique_lock<std::mutex> lock(mutex);
+            job_cond.wait(lock, [&] { return connection->pending == 0; });
+            lock.unlock();
+            if (!setup(*connection, request)) break;
+        }
+        else if (header.type == RENDER_FRAMES) {
+            Job job{connection, {}, {}, 0};
+            if (!readAll(connection->fd, &job.request, sizeof(job.request))) break;
+            // Read the poses even for a bad request so the stream stays in step
+            if (job.request.count > (1u << 20)) break;
+            job.poses.resize(job.request.count);
+            if (!readAll(connection->fd, job.poses.data(), job.poses.size() * sizeof(RenderPose))) break;
+            job.received_ns = nowNs();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connection->pending++;
+                jobs.push_back(std::move(job));
+            }
+            job_cond.notify_all();
+        }
+        else break;
+    }
+    connection->closed = true;
+#endif
+}
+
+bool RenderServer::setup(Connection& connection, const RenderSetup& request) {
+#ifdef __linux__
+    RenderSetupReply reply{RENDER_MAGIC, RENDER_OK, 0};
+    // Each product is checked, a wrapped one would pass the size limit and size the memory too small
+    uint64_t pixels = 0, frame_bytes = 0, slot_bytes = 0, memory_bytes = 0;
+    bool fits = !__builtin_mul_overflow(uint64_t(request.width), uint64_t(request.height), &pixels)
+        && !__builtin_mul_overflow(pixels, uint64_t(request.max_cameras), &pixels)
+        && !__builtin_mul_overflow(pixels, uint64_t(request.slots), &pixels)
+        && pixels <= RENDER_MAX_PIXELS;
+    if (fits) {
+        // Below the limit nothing here can wrap any more
+        frame_bytes = uint64_t(request.width) * request.height * sizeof(uint32_t);
+        slot_bytes = frame_bytes * request.max_cameras;
+        // Slots start on page boundaries so clients can map them one by one
+        slot_bytes = (slot_bytes + 4095) & ~uint64_t(4095);
+        memory_bytes = slot_bytes * request.slots;
+    }
+    int memory_fd = -1;
+    if (request.width == 0 || request.height == 0 || request.slots == 0 || request.max_cameras == 0 || !fits) {
+        reply.status = RENDER_BAD_REQUEST;
+    }
+    else {
+        memory_fd = memfd_create("portal-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        void* memory = MAP_FAILED;
+        if (memory_fd >= 0 && ftruncate(memory_fd, memory_bytes) == 0)
+            memory = mmap(nullptr, memory_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+        if (memory == MAP_FAILED) {
+            reply.status = RENDER_NO_MEMORY;
+        }
+        else {
+            // The client can rely on the size staying put
+            fcntl(memory_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+            if (connection.memory) munmap(connection.memory, connection.memory_bytes);
+            connection.memory = static_cast<uint8_t*>(memory);
+            connection.memory_bytes = memory_bytes;
+            connection.slots = request.slots;
+            connection.max_cameras = request.max_cameras;
+            connection.width = request.width;
+            connection.height = request.height;
+            connection.slot_bytes = reply.slot_bytes = slot_bytes;
+        }
+    }
+
+    // The memfd goes along as ancillary data
+    iovec data{&reply, sizeof(reply)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    if (reply.status == RENDER_OK) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* attached = CMSG_FIRSTHDR(&message);
+        attached->cmsg_level = SOL_SOCKET;
+        attached->cmsg_type = SCM_RIGHTS;
+        attached->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(attached), &memory_fd, sizeof(int));
+    }
+    bool sent;
+    {
+        std::lock_guard<std::mutex> lock(connection.send_mutex);
+        sent = sendmsg(connection.fd, &message, MSG_NOSIGNAL) == ssize_t(sizeof(reply));
+    }
+    // The client has its own reference now, the mapping keeps the memory alive for us
+    if (memory_fd >= 0) close(memory_fd);
+    return sent;
+#else
+    (void)connection;
+    (void)request;
+    return false;
+#endif
+}
+
+void RenderServer::renderJobs() {
+#ifdef __linux__
+    std::vector<Player> cameras;
+    std::vector<Framebuffer> frames;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_cond.wait(lock, [&] { return finished || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Connection& connection = *job.connection;
+        const RenderFrames& request = job.request;
+        RenderFramesReply reply{RENDER_MAGIC, request.id, request.slot, RENDER_OK, 0, 0};
+        uint64_t start_ns = nowNs();
+        reply.queue_ns = start_ns - job.received_ns;
+        if (!connection.memory || request.slot >= connection.slots || request.count > connection.max_cameras) {
+            reply.status = RENDER_BAD_REQUEST;
+        }
+        else {
+            cameras.clear();
+            frames.clear();
+            uint8_t* slot = connection.memory + request.slot * connection.slot_bytes;
+            size_t frame_bytes = size_t(connection.width) * connection.height * sizeof(uint32_t);
+            for (uint32_t i = 0; i < request.count; i++) {
+                const RenderPose& pose = job.poses[i];
+                cameras.push_back({{pose.x, pose.y, pose.z}, pose.angle});
+                frames.emplace_back(connection.width, connection.height, reinterpret_cast<uint32_t*>(slot + i * frame_bytes));
+                // Cameras outside the map leave their frame as it is, make that black
+                frames.back().clear(RGBA{0, 0, 0, 255});
+            }
+            batch.render(map, cameras.data(), frames.data(), request.count);
+        }
+        reply.render_ns = nowNs() - start_ns;
+        {
+            std::lock_guard<std::mutex> lock(connection.send_mutex);
+            writeAll(connection.fd, &reply, sizeof(reply));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connection.pending--;
+        }
+        // Readers waiting to change their frame memory check again
+        job_cond.notify_all();
+
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        latency_ns.push_back(nowNs() - job.received_ns);
+        queue_total_ns += reply.queue_ns;
+        render_total_ns += reply.render_ns;
+    }
+#endif
+}
+
+std::vector<uint64_t> RenderServer::latencies() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    return latency_ns;
+}
+
+void RenderServer::printStats() {
+    std::vector<uint64_t> sorted = latencies();
+    if (sorted.empty()) {
+        std::cout << "No requests served" << std::endl;
+        return;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))] / 1e6; };
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    std::cout << "Served " << sorted.size() << " requests, latency p50 " << percentile(0.5) << " ms, p95 " << percentile(0.95)
+              << " ms, p99 " << percentile(0.99) << " ms, max " << sorted.back() / 1e6 << " ms, mean queued "
+              << queue_total_ns / 1e6 / sorted.size() << " ms, mean render " << render_total_ns / 1e6 / sorted.size() << " ms" << std::endl;
+}
+
+RenderClient::RenderClient() : fd(-1), memory(nullptr), memory_bytes(0), slot_bytes(0), frame_width(0), frame_height(0) {}
+
+RenderClient::~RenderClient() {
+#ifdef __linux__
+    if (memory) munmap(memory, memory_bytes);
+    if (fd >= 0) close(fd);
+#endif
+}
+
+bool RenderClient::connect(const std::string& path, int slots, int max_cameras, int width, int height) {
+#ifdef __linux__
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::strcpy(address.sun_path, path.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) return false;
+
+    RenderHeader header{RENDER_MAGIC, RENDER_SETUP};
+    RenderSetup setup{uint32_t(slots), uint32_t(max_cameras), uint32_t(width), uint32_t(height)};
+    if (!writeAll(fd, &header, sizeof(header)) || !writeAll(fd, &setup, sizeof(setup))) return false;
+
+    RenderSetupReply reply;
+    iovec data{&reply, sizeof(reply)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &message, MSG_CMSG_CLOEXEC) != ssize_t(sizeof(reply)) || reply.magic != RENDER_MAGIC || reply.status != RENDER_OK)
+        return false;
+    cmsghdr* attached = CMSG_FIRSTHDR(&message);
+    if (!attached || attached->cmsg_type != SCM_RIGHTS) return false;
+    int memory_fd;
+    std::memcpy(&memory_fd, CMSG_DATA(attached), sizeof(int));
+    memory_bytes = reply.slot_bytes * slots;
+    void* mapped = mmap(nullptr, memory_bytes, PROT_READ, MAP_SHARED, memory_fd, 0);
+    close(memory_fd);
+    if (mapped == MAP_FAILED) return false;
+    memory = static_cast<uint8_t*>(mapped);
+    slot_bytes = reply.slot_bytes;
+    frame_width = width;
+    frame_height = height;
+    return true;
+#else
+    (void)path; (void)slots; (void)max_cameras; (void)width; (void)height;
+    return false;
+#endif
+}
+
+bool RenderClient::submit(uint32_t id, int slot, const Player* cameras, int count) {
+#ifdef __linux__
+    // One write for the whole request
+    std::vector<uint8_t> message(sizeof(RenderHeader) + sizeof(RenderFrames) + count * sizeof(RenderPose));
+    RenderHeader header{RENDER_MAGIC, RENDER_FRAMES};
+    RenderFrames request{id, uint32_t(slot), uint32_t(count)};
+    std::memcpy(message.data(), &header, sizeof(header));
+    std::memcpy(message.data() + sizeof(header), &request, sizeof(request));
+    RenderPose* poses = reinterpret_cast<RenderPose*>(message.data() + sizeof(header) + sizeof(request));
+    for (int i = 0; i < count; i++)
+        poses[i] = {cameras[i].pos.x, cameras[i].pos.y, cameras[i].pos.z, cameras[i].angle};
+    return writeAll(fd, message.data(), message.size());
+#else
+    (void)id; (void)slot; (void)cameras; (void)count;
+    return false;
+#endif
+}
+
+bool RenderClient::receive(RenderFramesReply& reply) {
+#ifdef __linux__
+    return readAll(fd, &reply, sizeof(reply)) && reply.magic == RENDER_MAGIC;
+#else
+    (void)reply;
+    return false;
+#endif
+}
+
+const uint32_t* RenderClient::frame(int slot, int index) const {
+    return reinterpret_cast<const uint32_t*>(memory + slot * slot_bytes + size_t(index) * frame_width * frame_height * sizeof(uint32_t));
+}
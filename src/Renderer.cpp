@@ -0,0 +1,189 @@
+#include "Renderer.h"
+#include <algorithm>
+#include <cmath>
+
+Renderer::Renderer(int max_portal_depth) :
+    max_portal_depth(std::max(max_portal_depth, 0)),
+    arena((std::max(max_portal_depth, 0) + 1) * sizeof(PortalStep) + 64),
+    steps(nullptr),
+    stats(nullptr),
+    interleave(INTERLEAVE_OFF),
+    history_width(0), history_height(0),
+    history_pose{{0, 0, 0}, 0},
+    frame_time(0.0), history_time(0.0),
+    history_valid(false), last_full(true),
+    parity(0)
+{
+}
+
+void RenderStats::reset(int width, int height) {
+    total_writes = walls_tested = portals_crossed = 0;
+    if (!detailed) return;
+    this->width = width;
+    this->height = height;
+    pixel_writes.assign(width * height, 0);
+    column_walls.assign(width, 0);
+    column_portals.assign(width, 0);
+}
+
+void Renderer::setMaxPortalDepth(int depth) {
+    max_portal_depth = std::max(depth, 0);
+    arena.reserve((max_portal_depth + 1) * sizeof(PortalStep) + 64);
+}
+
+void Renderer::setInterleave(const InterleaveSettings& settings) {
+    interleave = settings;
+    history_valid = false;
+}
+
+void Renderer::allocSteps() {
+    arena.reset();
+    steps = arena.alloc<PortalStep>(max_portal_depth + 1);
+    // Sized for the depth limit, so this only happens if that sizing is ever wrong
+    if (!steps) {
+        arena.reserve((max_portal_depth + 1) * sizeof(PortalStep) + alignof(PortalStep));
+        steps = arena.alloc<PortalStep>(max_portal_depth + 1);
+    }
+}
+
+void Renderer::beginFrame(const Map& map) {
+    allocSteps();
+    walker.prepare(map);
+}
+
+void Renderer::beginFrame(const CompactMap& map) {
+    allocSteps();
+    walker.prepare(map);
+}
+
+void Renderer::renderWorld(const Map& map, const Player& player, Framebuffer& frame) {
+    renderView(map, player, frame);
+}
+
+void Renderer::renderWorld(const CompactMap& map, const Player& player, Framebuffer& frame) {
+    renderView(map, player, frame);
+}
+
+void Renderer::renderColumn(const Map& map, const Player& player, Framebuffer& frame, int sector_id, int col) {
+    renderSteps(map, player, frame, sector_id, col);
+}
+
+void Renderer::renderColumn(const CompactMap& map, const Player& player, Framebuffer& frame, int sector_id, int col) {
+    renderSteps(map, player, frame, sector_id, col);
+}
+
+template<class M> void Renderer::renderView(const M& map, const Player& player, Framebuffer& frame) {
+    beginFrame(map);
+    if (stats) stats->reset(frame.width, frame.height);
+    int player_sector = map.locateSector(player.pos.xy());
+    if (player_sector < 0) {
+        history_valid = false;
+        return;
+    }
+    last_full = true;
+    if (interleave.block <= 0) {
+        for (int column = 0; column < frame.width; column++)
+            renderSteps(map, player, frame, player_sector, column);
+        return;
+    }
+
+    // Columns are cast into the history and the whole of it is copied out. The caller's
+    // frames rotate through the pipeline, so the history is the only copy of the last image.
+    // Casting into the frame instead and trading only the kept and cast columns with the
+    // history touches the same cache lines and measured slower than one straight copy.
+    if (history_width != frame.width || history_height != frame.height) {
+        history.assign(frame.size(), 0);
+        history_width = frame.width;
+        history_height = frame.height;
+        history_valid = false;
+    }
+    // Speeds as motion against the time since the kept frame, time going backwards casts everything
+    float dt = float(frame_time - history_time);
+    last_full = !history_valid || (stats && stats->detailed)
+        || std::abs(player.angle - history_pose.angle) > interleave.max_turn_rate * dt
+        || linalg::length(player.pos - history_pose.pos) > interleave.max_speed * dt;
+    Framebuffer target(frame.width, frame.height, history.data());
+    for (int column = 0; column < frame.width; column++) {
+        if (last_full || (column / interleave.block & 1) == parity)
+            renderSteps(map, player, target, player_sector, column);
+    }
+    std::copy(history.begin(), history.end(), frame.pixels);
+    parity ^= 1;
+    history_pose = player;
+    history_time = frame_time;
+    history_valid = true;
+}
+
+template<class M> void Renderer::renderSteps(const M& map, const Player& player, Framebuffer& frame, int sector_id, int col) {
+    const int window_width = frame.width, window_height = frame.height;
+    int depth = walker.walk(map, player, columnAngle(player, col, window_width, window_height), sector_id, max_portal_depth, steps);
+
+    if (stats) {
+        int walls = 0;
+        for (int d = 0; d <= depth; d++)
+            walls += map.wallsEnd(steps[d].sector) - map.wallsBegin(steps[d].sector) + 1;
+        stats->walls_tested += walls;
+        stats->portals_crossed += depth;
+        if (stats->detailed) {
+            stats->column_walls[col] += walls;
+            stats->column_portals[col] += depth;
+        }
+    }
+
+    // Baked maps shade every span by its light level instead of by distance
+    const bool lit = map.lit();
+    auto shade = [](unsigned char r, unsigned char g, unsigned char b, float light) {
+        return RGBA {(unsigned char) (r * light), (unsigned char) (g * light), (unsigned char) (b * light), 255};
+    };
+
+    // Draw back to front so nearer sectors end up on top
+    for (int d = depth; d >= 0; d--) {
+        const PortalStep& step = steps[d];
+        const float sector_ceil = map.sectorCeil(step.sector), sector_floor = map.sectorFloor(step.sector);
+        float dist_closest = step.dist;
+
+        // Find top and bottom of the wall or portal
+        int wall_top = window_height/2 - (window_height/dist_closest * (sector_ceil  - player.pos.z)) / (FOV);
+        int wall_bot = window_height/2 + (window_height/dist_closest * (sector_floor + player.pos.z)) / (FOV);
+
+        // if the wall exists
+        if (step.wall >= 0) {
+            // if the wall does not continue to another sector, or the walk stopped at it
+            if (d == depth) {
+                if (lit) drawColumn(frame, col, wall_top, wall_bot, shade(0, 0, 255, map.lighting.walls[step.wall]));
+                else drawColumn(frame, col, wall_top, wall_bot, RGBA {0, 0, (unsigned char) (255/std::max(dist_closest+1.0f, 1.0f)), 255} );
+            }
+            // if the wall does go to another sector, the next sector is already drawn
+            else {
+                const float next_ceil = map.sectorCeil(steps[d+1].sector), next_floor = map.sectorFloor(steps[d+1].sector);
+                float light = lit ? map.lighting.walls[step.wall] : 1.0f;
+
+                // Render top and bottom
+                int topTop = window_height/2 - (window_height/dist_closest * (sector_ceil - player.pos.z)) / (FOV);
+                int botTop = window_height/2 - (window_height/dist_closest * (next_ceil - player.pos.z)) / (FOV);
+                drawColumn(frame, col, topTop, botTop, shade(255, 0, 255, light));
+
+                int botBot = window_height/2 + (window_height/dist_closest * (next_floor + player.pos.z)) / (FOV);
+                int topBot = window_height/2 + (window_height/dist_closest * (sector_floor + player.pos.z)) / (FOV);
+                drawColumn(frame, col, topBot, botBot, shade(255, 255, 0, light));
+            }
+        }
+        // Draw the ceiling and floor of the sector
+        float ceil_light = lit ? map.lighting.ceils[step.sector] : 1.0f;
+        float floor_light = lit ? map.lighting.floors[step.sector] : 1.0f;
+        if (wall_top > 0) drawColumn(frame, col, 0, wall_top, shade(0, 255, 0, ceil_light));
+        if (wall_bot < window_height) drawColumn(frame, col, window_height, wall_bot, shade(255, 0, 0, floor_light));
+    }
+}
+
+void Renderer::drawColumn(Framebuffer& frame, int col, int y1, int y2, RGBA clr) {
+    frame.drawColumn(col, y1, y2, clr);
+    if (!stats || !stats->detailed || col < 0 || col >= stats->width) return;
+    // Same clipping as Framebuffer::drawColumn
+    if (y1 > y2) std::swap(y1, y2);
+    y1 = std::max(y1, 0);
+    y2 = std::min(y2, stats->height - 1);
+    for (int y = y1; y <= y2; y++)
+        stats->pixel_writes[y * stats->width + col]++;
+    if (y2 >= y1) stats->total_writes += y2 - y1 + 1;
+}
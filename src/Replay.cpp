@@ -0,0 +1,52 @@
+#include "Replay.h"
+#include <cstring>
+
+static const char REPLAY_MAGIC[4] = {'P', 'E', 'I', 'R'};
+static const uint32_t REPLAY_VERSION = 1;
+
+template<class T> static void put(std::ofstream& file, T value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T> static bool get(std::ifstream& file, T& value) {
+    return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool InputRecorder::open(const std::string& path, const Player& start) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    put(file, REPLAY_VERSION);
+    put(file, start.pos.x);
+    put(file, start.pos.y);
+    put(file, start.pos.z);
+    put(file, start.angle);
+    return bool(file);
+}
+
+void InputRecorder::write(const InputFrame& input) {
+    put(file, input.dt_seconds);
+    put(file, input.mouse_dx);
+    put(file, input.wheel_y);
+    put(file, input.keys);
+    put(file, input.presses);
+}
+
+bool InputReplay::open(const std::string& path, Player& start) {
+    file.open(path, std::ios::binary);
+    if (!file) return false;
+    char magic[4];
+    uint32_t version;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0
+        || !get(file, version) || version != REPLAY_VERSION
+        || !get(file, start.pos.x) || !get(file, start.pos.y) || !get(file, start.pos.z) || !get(file, start.angle)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool InputReplay::next(InputFrame& input) {
+    return get(file, input.dt_seconds) && get(file, input.mouse_dx) && get(file, input.wheel_y)
+        && get(file, input.keys) && get(file, input.presses);
+}
@@ -0,0 +1,57 @@
+#include "Visibility.h"
+#include <algorithm>
+
+VisibilityQuery::VisibilityQuery(int max_portal_depth) :
+    max_portal_depth(std::max(max_portal_depth, 0)),
+    steps(this->max_portal_depth + 1),
+    query_stamp(0)
+{
+}
+
+void VisibilityQuery::query(const Map& map, const Player& camera, int width, int height, VisibleSet& result, bool coverage) {
+    result.sectors.clear();
+    result.walls.clear();
+    result.wall_columns.clear();
+
+    walker.prepare(map);
+    if (sector_seen.size() != map.sectors.size()) {
+        sector_seen.assign(map.sectors.size(), 0);
+        query_stamp = 0;
+    }
+    if (wall_seen.size() != map.walls.size()) {
+        wall_seen.assign(map.walls.size(), 0);
+        wall_index.resize(map.walls.size());
+        query_stamp = 0;
+    }
+    if (++query_stamp == 0) {
+        std::fill(sector_seen.begin(), sector_seen.end(), 0);
+        std::fill(wall_seen.begin(), wall_seen.end(), 0);
+        query_stamp = 1;
+    }
+
+    int camera_sector = map.locateSector(camera.pos.xy());
+    if (camera_sector < 0) return;
+
+    for (int col = 0; col < width; col++) {
+        int depth = walker.walk(map, camera, columnAngle(camera, col, width, height), camera_sector, max_portal_depth, steps.data());
+        for (int d = 0; d <= depth; d++) {
+            const PortalStep& step = steps[d];
+            if (sector_seen[step.sector] != query_stamp) {
+                sector_seen[step.sector] = query_stamp;
+                result.sectors.push_back(step.sector);
+            }
+            if (step.wall < 0) continue;
+            if (wall_seen[step.wall] != query_stamp) {
+                wall_seen[step.wall] = query_stamp;
+                wall_index[step.wall] = result.walls.size();
+                result.walls.push_back(step.wall);
+                if (coverage) result.wall_columns.push_back({col, col});
+            }
+            else if (coverage) {
+                int2& columns = result.wall_columns[wall_index[step.wall]];
+                columns.x = std::min(columns.x, col);
+                columns.y = std::max(columns.y, col);
+            }
+        }
+    }
+}
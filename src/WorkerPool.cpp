@@ -0,0 +1,62 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads) :
+    task(nullptr), context(nullptr), count(0), chunk(1), next(0),
+    generation(0), loop_workers(0), busy_workers(0), stopping(false)
+{
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < threads; i++)
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cond.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void WorkerPool::run(int count, int chunk, Task task, void* context) {
+    if (count <= 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = task;
+        this->context = context;
+        this->count = count;
+        this->chunk = std::max(chunk, 1);
+        next = 0;
+        // Small loops aren't worth waking everyone up for
+        loop_workers = busy_workers = std::min<int>(workers.size(), (count - 1) / this->chunk);
+        generation++;
+    }
+    if (loop_workers > 0) start_cond.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [&] { return busy_workers == 0; });
+}
+
+void WorkerPool::workerLoop(int thread) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Only the first loop_workers workers take part in a loop
+            start_cond.wait(lock, [&] { return stopping || (generation != seen && thread <= loop_workers); });
+            if (stopping) return;
+            seen = generation;
+        }
+        work(thread);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy_workers == 0) done_cond.notify_all();
+    }
+}
+
+void WorkerPool::work(int thread) {
+    int begin;
+    while ((begin = next.fetch_add(chunk)) < count)
+        task(context, begin, std::min(begin + chunk, count), thread);
+}
@@ -1,18 +1,65 @@
 #include "Engine.h"
+#include <cstdlib>
+#include <iostream>
 
 int main(int argc, char** argv) {
-    //std::vector<char*> arguments;
-    //arguments.assign(argv, argv + argc);
-    //for (char* arg : arguments) {
-    //    std::cout << arg << "\n";
-    //}
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    // Capturing to stdout, every message goes to stderr so the video stays clean
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2)
+        if (arguments[i] == "--capture" && arguments[i+1] == "-") std::cout.rdbuf(std::cerr.rdbuf());
+    std::string map_path = "map";
+    std::string record_path, replay_path, timing_path = "timing.csv", movers_path, capture_path;
+    CaptureFormat capture_format = CAPTURE_Y4M;
+    int capture_fps = 60;
+    bool hud = false;
+    double fixed_dt = 0.0;
+    int portal_depth = DEFAULT_MAX_PORTAL_DEPTH;
+    int frames_in_flight = 1;
+    int compact_precision = -1;
+    int interleave = 0;
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--map")            map_path = arguments[i+1];
+        else if (arguments[i] == "--record")    record_path = arguments[i+1];
+        else if (arguments[i] == "--replay")    replay_path = arguments[i+1];
+        else if (arguments[i] == "--timing")    timing_path = arguments[i+1];
+        else if (arguments[i] == "--dt")        fixed_dt = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--portal-depth") portal_depth = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--frames-in-flight") frames_in_flight = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--compact-map") compact_precision = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--interleave") interleave = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--movers")    movers_path = arguments[i+1];
+        else if (arguments[i] == "--hud")       hud = std::atoi(arguments[i+1].c_str()) != 0;
+        else if (arguments[i] == "--capture")   capture_path = arguments[i+1];
+        else if (arguments[i] == "--capture-fps") capture_fps = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--capture-format") {
+            if (!parseCaptureFormat(arguments[i+1], capture_format))
+                std::cout << "Unknown capture format " << arguments[i+1] << "\n";
+        }
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
 
-    Engine engine(1200, 900);
+    // Replays run without a window
+    Engine engine(1200, 900, map_path, !replay_path.empty());
+    engine.setMaxPortalDepth(portal_depth);
+    engine.setFramesInFlight(frames_in_flight);
+    engine.showHud(hud);
+    engine.setInterleave(interleave);
+    if (compact_precision >= 0) engine.useCompactMap(compact_precision);
+    if (!movers_path.empty() && !engine.loadMovers(movers_path))
+        std::cout << "Could not read " << movers_path << "\n";
+    if (!record_path.empty() && !engine.record(record_path))
+        std::cout << "Could not record to " << record_path << "\n";
+    if (!capture_path.empty() && !engine.capture(capture_path, capture_format, capture_fps))
+        std::cout << "Could not capture to " << capture_path << "\n";
+    if (!replay_path.empty() && !engine.replay(replay_path, timing_path, fixed_dt)) {
+        std::cout << "Could not replay " << replay_path << "\n";
+        return 1;
+    }
     while(engine.running) {
         engine.startFrame();
+        if (!engine.running) break; // replay exhausted
         engine.events();
         engine.update();
         engine.render();
     }
 }
-
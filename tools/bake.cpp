@@ -0,0 +1,52 @@
+// Bakes point light levels into a map file.
+//
+//     bake --map file --lights file [--out file] [--samples n] [--ambient 0..1] [--threads n]
+//
+// The output is the map with a light section appended, by default written over the input.
+
+#include <Map.h>
+#include <LightBake.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    BakeParams params{4, 0.1f, 0};
+    std::string map_path = "map", lights_path = "lights", out_path;
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--map")            map_path = arguments[i+1];
+        else if (arguments[i] == "--lights")    lights_path = arguments[i+1];
+        else if (arguments[i] == "--out")       out_path = arguments[i+1];
+        else if (arguments[i] == "--samples")   params.samples = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--ambient")   params.ambient = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--threads")   params.threads = std::atoi(arguments[i+1].c_str());
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+    if (out_path.empty()) out_path = map_path;
+
+    Map map;
+    if (!map.load(map_path)) {
+        std::cout << "Could not read " << map_path << "\n";
+        return 1;
+    }
+    std::vector<PointLight> lights;
+    if (!readLightFile(lights_path, lights)) {
+        std::cout << "Could not read " << lights_path << "\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MapLighting lighting;
+    bakeLighting(map, lights, params, lighting);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!writeMapFile(out_path, map.walls, map.sectors, &lighting)) {
+        std::cout << "Could not write " << out_path << "\n";
+        return 1;
+    }
+    std::cout << "Baked " << lights.size() << " lights into " << map.walls.size() << " walls and "
+              << map.sectors.size() << " sectors in " << seconds * 1000.0 << " ms, wrote " << out_path << "\n";
+}
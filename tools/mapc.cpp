@@ -0,0 +1,223 @@
+// Validates a map and renumbers it for cache locality.
+//
+//     mapc --map file [--out file] [--order hilbert|bfs|none]
+//     mapc --report
+//
+// Errors are printed and nothing is written. Otherwise sectors and walls are
+// renumbered so sectors that are traversed together sit next to each other in
+// memory, and the map is written to --out (the input by default).
+//
+// --report compiles the generated benchmark maps, in their generated order and
+// shuffled the way an edited map ends up, and prints the cache misses of the portal
+// walk in a simulated cold cache and frame times for every order.
+
+#include <Map.h>
+#include <MapGen.h>
+#include <MapCompiler.h>
+#include <Renderer.h>
+#include <PortalWalker.h>
+#include <Framebuffer.h>
+#include <Player.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+const int REPORT_WIDTH      = 640;
+const int REPORT_HEIGHT     = 480;
+const int REPORT_CAMERAS    = 32;
+
+// Set associative cache with LRU replacement, counts misses for the addresses it is fed
+class CacheModel {
+public:
+    CacheModel(int bytes, int ways) : ways(ways), sets(bytes / LINE / ways), tags(sets * ways, UINT64_MAX), misses(0) {}
+
+    void touch(uint64_t address) {
+        uint64_t line = address / LINE;
+        uint64_t* set = &tags[(line % sets) * ways];
+        int hit = ways - 1;
+        for (int i = 0; i < ways; i++)
+            if (set[i] == line) hit = i;
+        if (set[hit] != line) misses++;
+        // Most recently used first
+        for (int i = hit; i > 0; i--)
+            set[i] = set[i - 1];
+        set[0] = line;
+    }
+    void clear() { std::fill(tags.begin(), tags.end(), UINT64_MAX); }
+    void touchRange(uint64_t begin, uint64_t end) {
+        for (uint64_t line = begin / LINE; line <= (end - 1) / LINE; line++)
+            touch(line * LINE);
+    }
+
+    static const int LINE = 64;
+    int ways, sets;
+    std::vector<uint64_t> tags;
+    unsigned long misses;
+};
+
+struct OrderReport {
+    double l1_misses, l2_misses;    // Per frame
+    double frame_ms;
+};
+
+// Replays the memory accesses of the portal walk for every column of a frame through
+// an L1 and an L2 sized cache, starting cold for every camera, then times real frames
+// from the same cameras
+static OrderReport measure(const Map& map, const std::vector<Player>& cameras) {
+    // Where the walk's arrays would live, apart and not aligned to each other
+    const uint64_t SECTORS = 1ull << 40, WALLS = (2ull << 40) + 4160, EDGES = (3ull << 40) + 8384, VISITED = (4ull << 40) + 12608;
+    CacheModel l1(32 << 10, 8), l2(1 << 20, 16);
+    PortalWalker walker;
+    walker.prepare(map);
+    std::vector<PortalStep> steps(map.sectors.size() + 1);
+    unsigned long frames = 0;
+    for (const Player& camera : cameras) {
+        int sector_id = map.locateSector(camera.pos.xy());
+        if (sector_id < 0) continue;
+        l1.clear();
+        l2.clear();
+        frames++;
+        for (int col = 0; col < REPORT_WIDTH; col++) {
+            int depth = walker.walk(map, camera, columnAngle(camera, col, REPORT_WIDTH, REPORT_HEIGHT), sector_id, map.sectors.size(), steps.data());
+            for (int d = 0; d <= depth; d++) {
+                int id = steps[d].sector;
+                const Sector& sector = map.sectors[id];
+                for (CacheModel* cache : {&l1, &l2}) {
+                    cache->touch(SECTORS + id * sizeof(Sector));
+                    cache->touch(VISITED + id * sizeof(uint32_t));
+                    cache->touchRange(EDGES + sector.walls_begin * sizeof(float2), EDGES + (sector.walls_end + 1) * sizeof(float2));
+                    cache->touchRange(WALLS + sector.walls_begin * sizeof(Wall), WALLS + (sector.walls_end + 1) * sizeof(Wall));
+                }
+            }
+        }
+    }
+
+    Renderer renderer(map.sectors.size());
+    Framebuffer frame(REPORT_WIDTH, REPORT_HEIGHT);
+    double best = INFINITY;
+    for (int repeat = 0; repeat < 3; repeat++) {
+        auto start = std::chrono::steady_clock::now();
+        for (const Player& camera : cameras)
+            renderer.renderWorld(map, camera, frame);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    frames = std::max(frames, 1ul);
+    return {double(l1.misses) / frames, double(l2.misses) / frames, 1000.0 * best / cameras.size()};
+}
+
+static void printReport(const std::string& name, const OrderReport& report, const OrderReport* baseline) {
+    std::cout << "  " << name << ": L1 misses " << report.l1_misses << ", L2 misses " << report.l2_misses
+              << " per frame, " << report.frame_ms << " ms per frame";
+    if (baseline)
+        std::cout << " (L1 " << 100.0 * (report.l1_misses / baseline->l1_misses - 1.0) << "%, L2 "
+                  << 100.0 * (report.l2_misses / baseline->l2_misses - 1.0) << "%, time "
+                  << 100.0 * (report.frame_ms / baseline->frame_ms - 1.0) << "%)";
+    std::cout << "\n";
+}
+
+static int runReport() {
+    struct ReportMap {
+        const char* name;
+        MapLayout layout;
+        int sectors, walls_per_sector;
+    };
+    const ReportMap maps[] = {
+        {"corridor_1024",   LAYOUT_CORRIDOR,    1024,   4},
+        {"grid_1024",       LAYOUT_GRID,        1024,   8},
+        {"maze_4096",       LAYOUT_MAZE,        4096,   8},
+        {"maze_65536",      LAYOUT_MAZE,        65536,  8},
+    };
+    for (const ReportMap& report_map : maps) {
+        Map generated;
+        generateMap({report_map.layout, report_map.sectors, report_map.walls_per_sector, 0.5f, 1, 4.0f}, generated.walls, generated.sectors);
+        generated.build();
+
+        // Cameras in the middle of sectors spread over the map, looking different ways
+        std::vector<Player> cameras;
+        for (int i = 0; i < REPORT_CAMERAS; i++) {
+            const SectorBounds& b = generated.bounds[size_t(i) * generated.bounds.size() / REPORT_CAMERAS];
+            float2 centre = (b.min + b.max) * 0.5f;
+            cameras.push_back({{centre.x, centre.y, 0}, i * 0.9f});
+        }
+
+        // What a map looks like after sectors were added and deleted in no particular order
+        Map shuffled = generated;
+        std::vector<int> order(shuffled.sectors.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::mt19937 random(1);
+        for (size_t i = order.size() - 1; i > 0; i--)
+            std::swap(order[i], order[random() % (i + 1)]);
+        reorderMap(order, shuffled.walls, shuffled.sectors);
+        shuffled.build();
+
+        std::cout << report_map.name << "\n";
+        OrderReport generated_report = measure(generated, cameras);
+        OrderReport shuffled_report = measure(shuffled, cameras);
+        printReport("generated", generated_report, nullptr);
+        printReport("shuffled", shuffled_report, nullptr);
+        for (SectorOrder sector_order : {ORDER_BFS, ORDER_HILBERT}) {
+            for (const Map* source : {&generated, &shuffled}) {
+                Map compiled = *source;
+                reorderMap(sectorOrder(compiled.walls, compiled.sectors, sector_order), compiled.walls, compiled.sectors);
+                compiled.build();
+                std::string name = std::string(sector_order == ORDER_BFS ? "bfs" : "hilbert") + (source == &generated ? " from generated" : " from shuffled");
+                printReport(name, measure(compiled, cameras), source == &generated ? &generated_report : &shuffled_report);
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    std::string map_path = "map", out_path, order_name = "hilbert";
+    if (std::find(arguments.begin(), arguments.end(), "--report") != arguments.end()) return runReport();
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--map")            map_path = arguments[i+1];
+        else if (arguments[i] == "--out")       out_path = arguments[i+1];
+        else if (arguments[i] == "--order")     order_name = arguments[i+1];
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+    if (out_path.empty()) out_path = map_path;
+
+    std::vector<Wall> walls;
+    std::vector<Sector> sectors;
+    MapLighting lighting;
+    if (!readMapFile(map_path, walls, sectors, &lighting)) {
+        std::cout << "Could not read " << map_path << "\n";
+        return 1;
+    }
+
+    std::vector<MapDiagnostic> diagnostics;
+    int errors = validateMap(walls, sectors, diagnostics);
+    for (const MapDiagnostic& diagnostic : diagnostics) {
+        std::cout << map_path << ": " << (diagnostic.error ? "error: " : "warning: ");
+        if (diagnostic.sector >= 0) std::cout << "sector " << diagnostic.sector << (diagnostic.wall >= 0 ? " " : ": ");
+        if (diagnostic.wall >= 0) std::cout << "wall " << diagnostic.wall << ": ";
+        std::cout << diagnostic.message << "\n";
+    }
+    if (errors > 0) {
+        std::cout << errors << " errors, " << diagnostics.size() - errors << " warnings, nothing written\n";
+        return 1;
+    }
+
+    if (order_name != "none") {
+        SectorOrder order;
+        if (!parseSectorOrder(order_name, order)) {
+            std::cout << "Unknown order " << order_name << "\n";
+            return 1;
+        }
+        reorderMap(sectorOrder(walls, sectors, order), walls, sectors, &lighting);
+    }
+    if (!writeMapFile(out_path, walls, sectors, &lighting)) {
+        std::cout << "Could not write " << out_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << out_path << ": " << walls.size() << " walls, " << sectors.size() << " sectors, "
+              << diagnostics.size() << " warnings\n";
+}
@@ -0,0 +1,41 @@
+// Writes procedurally generated maps for scaling tests.
+//
+//     mapgen [--layout grid|maze|corridor|open] [--sectors n] [--walls n]
+//            [--portals 0..1] [--seed n] [--room-size units] [--out file]
+
+#include <Map.h>
+#include <MapGen.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    MapGenParams params{LAYOUT_GRID, 64, 4, 0.5f, 1, 4.0f};
+    std::string out_path = "map";
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--layout") {
+            if (!parseLayout(arguments[i+1], params.layout)) {
+                std::cout << "Unknown layout " << arguments[i+1] << "\n";
+                return 1;
+            }
+        }
+        else if (arguments[i] == "--sectors")   params.sectors = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--walls")     params.walls_per_sector = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--portals")   params.portal_density = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--seed")      params.seed = std::strtoul(arguments[i+1].c_str(), NULL, 10);
+        else if (arguments[i] == "--room-size") params.room_size = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--out")       out_path = arguments[i+1];
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+
+    std::vector<Wall> walls;
+    std::vector<Sector> sectors;
+    generateMap(params, walls, sectors);
+    if (!writeMapFile(out_path, walls, sectors)) {
+        std::cout << "Could not write " << out_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << out_path << ": " << walls.size() << " walls, " << sectors.size() << " sectors\n";
+}
@@ -0,0 +1,125 @@
+// Load generator and example client for renderserver.
+//
+//     renderclient [--socket path] [--requests n] [--batch n] [--in-flight n] [--width n] [--height n]
+//                  [--x x] [--y y] [--check map] [--out file]
+//
+// Sends --requests requests of --batch cameras turning in place at x, y, keeping up to
+// --in-flight of them queued, and prints round trip times and the hash of the last frame.
+// --check renders the same frame in process and compares, --out writes it as a PPM image.
+
+#include <BatchRenderer.h>
+#include <Framebuffer.h>
+#include <Map.h>
+#include <Player.h>
+#include <RenderServer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static Player camera(float x, float y, int request, int index, int batch) {
+    return Player{{x, y, 0}, 0.01f * (request * batch + index)};
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    std::string socket_path = "/tmp/portal-render.sock", check_path, out_path;
+    int requests = 1000, batch = 4, in_flight = 4, width = 640, height = 480;
+    float x = 1, y = 1;
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--socket")         socket_path = arguments[i+1];
+        else if (arguments[i] == "--requests")  requests = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--batch")     batch = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--in-flight") in_flight = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--width")     width = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--height")    height = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--x")         x = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--y")         y = std::atof(arguments[i+1].c_str());
+        else if (arguments[i] == "--check")     check_path = arguments[i+1];
+        else if (arguments[i] == "--out")       out_path = arguments[i+1];
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+    requests = std::max(requests, 1);
+    batch = std::max(batch, 1);
+    in_flight = std::max(in_flight, 1);
+
+    // One slot per request in flight
+    RenderClient client;
+    if (!client.connect(socket_path, in_flight, batch, width, height)) {
+        std::cout << "Could not connect to " << socket_path << "\n";
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<Clock::time_point> sent(in_flight);
+    std::vector<double> round_trips;
+    std::vector<Player> cameras(batch);
+    double server_queue = 0, server_render = 0;
+    int submitted = 0, failed = 0, last_slot = 0;
+    auto start = Clock::now();
+    for (int received = 0; received < requests; received++) {
+        while (submitted < requests && submitted - received < in_flight) {
+            for (int i = 0; i < batch; i++)
+                cameras[i] = camera(x, y, submitted, i, batch);
+            int slot = submitted % in_flight;
+            sent[slot] = Clock::now();
+            if (!client.submit(submitted, slot, cameras.data(), batch)) {
+                std::cout << "Lost the connection\n";
+                return 1;
+            }
+            submitted++;
+        }
+        RenderFramesReply reply;
+        if (!client.receive(reply)) {
+            std::cout << "Lost the connection\n";
+            return 1;
+        }
+        if (reply.status != RENDER_OK) failed++;
+        round_trips.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent[reply.slot]).count());
+        server_queue += reply.queue_ns / 1e6;
+        server_render += reply.render_ns / 1e6;
+        last_slot = reply.slot;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(round_trips.begin(), round_trips.end());
+    auto percentile = [&](double p) { return round_trips[std::min(round_trips.size() - 1, size_t(p * round_trips.size()))]; };
+    std::cout << requests << " requests of " << batch << " " << width << "x" << height << " frames, " << failed << " failed, "
+              << requests * batch / seconds << " frames/s\n"
+              << "Round trip p50 " << percentile(0.5) << " ms, p95 " << percentile(0.95) << " ms, p99 " << percentile(0.99)
+              << " ms, max " << round_trips.back() << " ms, server queue " << server_queue / requests
+              << " ms, server render " << server_render / requests << " ms\n";
+
+    // The last reply's slot still holds its frames, nothing was sent after it
+    Framebuffer last(width, height, const_cast<uint32_t*>(client.frame(last_slot, batch - 1)));
+    std::cout << "Last frame hash " << std::hex << last.hash() << std::dec << "\n";
+
+    if (!check_path.empty()) {
+        Map map;
+        if (!map.load(check_path)) {
+            std::cout << "Could not read " << check_path << "\n";
+            return 1;
+        }
+        Player pose = camera(x, y, requests - 1, batch - 1, batch);
+        Framebuffer local(width, height);
+        local.clear(RGBA{0, 0, 0, 255});
+        BatchRenderer renderer(1);
+        renderer.render(map, &pose, &local, 1);
+        bool same = local.hash() == last.hash();
+        std::cout << (same ? "Matches" : "Differs from") << " the frame rendered in process\n";
+        if (!same) return 1;
+    }
+
+    if (!out_path.empty()) {
+        std::ofstream out(out_path, std::ios::binary);
+        out << "P6\n" << width << " " << height << "\n255\n";
+        for (size_t i = 0; i < last.size(); i++) {
+            uint32_t p = last.pixels[i];
+            char rgb[3] = {char(p >> 16), char(p >> 8), char(p)};
+            out.write(rgb, 3);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+// Serves rendered frames of a map over a UNIX domain socket, see RenderServer.h.
+//
+//     renderserver [--map file] [--socket path] [--threads n] [--portal-depth n]
+//
+// Runs until interrupted, then prints the latency of the requests it served.
+
+#include <Map.h>
+#include <RenderServer.h>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int) {
+    interrupted = 1;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    std::string map_path = "map", socket_path = "/tmp/portal-render.sock";
+    int threads = 0, portal_depth = DEFAULT_MAX_PORTAL_DEPTH;
+    for (size_t i = 0; i + 1 < arguments.size(); i += 2) {
+        if (arguments[i] == "--map")                map_path = arguments[i+1];
+        else if (arguments[i] == "--socket")        socket_path = arguments[i+1];
+        else if (arguments[i] == "--threads")       threads = std::atoi(arguments[i+1].c_str());
+        else if (arguments[i] == "--portal-depth")  portal_depth = std::atoi(arguments[i+1].c_str());
+        else std::cout << "Unknown argument " << arguments[i] << "\n";
+    }
+
+    Map map;
+    if (!map.load(map_path)) {
+        std::cout << "Could not read " << map_path << "\n";
+        return 1;
+    }
+    RenderServer server(map, threads, portal_depth);
+    if (!server.listen(socket_path)) {
+        std::cout << "Could not listen on " << socket_path << "\n";
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::cout << "Serving " << map_path << " on " << socket_path << std::endl;
+    server.run(&interrupted);
+    server.printStats();
+}